@@ -0,0 +1,32 @@
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * Get monotonic time in seconds
+ */
+static inline double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Warn that contention figures are meaningless without
+ * threads running in parallel
+ */
+static inline void bench_check_cpus(void)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (cpus < 2)
+        fprintf(stderr, "warning: %ld CPU online, threads don't run in "
+                "parallel and multi-thread results don't show "
+                "cross-core contention\n", cpus);
+}
+
+#endif /* BENCH_H_ */
@@ -0,0 +1,58 @@
+/*
+ * Resident bytes per object for short strings made by kref_strdub(),
+ * payload 16..64 bytes, with malloc and slab backends
+ */
+#include "kref_alloc.h"
+#include "bench.h"
+#include <stdlib.h>
+#include <unistd.h>
+
+#define NR_OBJECTS 1000000
+
+static void *objects[NR_OBJECTS];
+
+static long resident_bytes(void)
+{
+    long size, resident = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+
+    if (!f)
+        return 0;
+    if (fscanf(f, "%ld %ld", &size, &resident) != 2)
+        resident = 0;
+    fclose(f);
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+static void run(const char *name, uint flags)
+{
+    char str[65];
+    long start, payload = 0;
+    int i, len;
+
+    kref_alloc_init(flags);
+    memset(str, 'a', sizeof str - 1);
+    srand(1);
+
+    start = resident_bytes();
+    for (i = 0; i < NR_OBJECTS; i++) {
+        len = 16 + rand() % 49;
+        str[len] = 0;
+        objects[i] = kref_strdub(str);
+        str[len] = 'a';
+        payload += len + 1;
+    }
+    printf("%-7s %.1f bytes/object, payload %.1f bytes\n", name,
+           (double)(resident_bytes() - start) / NR_OBJECTS,
+           (double)payload / NR_OBJECTS);
+
+    for (i = 0; i < NR_OBJECTS; i++)
+        kmem_deref(objects + i);
+}
+
+int main(void)
+{
+    run("malloc", 0);
+    run("slab", KRALLOC_SLAB);
+    return 0;
+}
@@ -0,0 +1,118 @@
+/*
+ * Lookup of sessions by buffer key: LIST_FOREACH scan versus
+ * hash table with wyhash and FNV-1a, and insertion cost including
+ * incremental growth from the minimal table
+ */
+#include "buf.h"
+#include "hash.h"
+#include "bench.h"
+#include <stdlib.h>
+
+#define SESSIONS 10000
+#define LOOKUPS 1000000
+#define LIST_LOOKUPS 10000
+
+struct session {
+    struct hnode hn;
+    struct le le;
+    struct buf *id;
+};
+
+static struct session *sessions[SESSIONS];
+static struct buf *keys[SESSIONS];
+
+static void session_destructor(void *mem)
+{
+    struct session *s = (struct session *)mem;
+    buf_deref(&s->id);
+}
+
+static const void *session_key(const void *data, uint *len)
+{
+    return buf_key(((const struct session *)data)->id, len);
+}
+
+static struct session *list_lookup(struct list *list, struct buf *key)
+{
+    struct session *s;
+    struct le *le;
+
+    LIST_FOREACH(list, le) {
+        s = (struct session *)list_ledata(le);
+        if (buf_data_len(s->id) == buf_data_len(key) &&
+            !memcmp(s->id->data, key->data, buf_data_len(key)))
+            return s;
+    }
+    return NULL;
+}
+
+static void bench_list(void)
+{
+    struct list list = LIST_INIT;
+    double start;
+    uint i, found = 0;
+
+    for (i = 0; i < SESSIONS; i++)
+        list_append(&list, &sessions[i]->le, sessions[i]);
+
+    start = bench_now();
+    for (i = 0; i < LIST_LOOKUPS; i++)
+        found += list_lookup(&list, keys[rand() % SESSIONS]) != NULL;
+    printf("%-8s lookup %10.1f ns\n", "list",
+           (bench_now() - start) * 1e9 / LIST_LOOKUPS);
+
+    if (found != LIST_LOOKUPS)
+        printf("list: wrong result\n");
+    list_clear(&list);
+}
+
+static void bench_hash(const char *name, hash_fn fn)
+{
+    struct hash *h = hash_create(0, session_key, fn);
+    double start, t, max_add = 0;
+    uint i, found = 0;
+
+    start = bench_now();
+    for (i = 0; i < SESSIONS; i++) {
+        t = bench_now();
+        hash_add(h, &sessions[i]->hn, kmem_ref(sessions[i]));
+        t = bench_now() - t;
+        max_add = MAX(max_add, t);
+    }
+    printf("%-8s add    %10.1f ns, max %.1f us\n", name,
+           (bench_now() - start) * 1e9 / SESSIONS, max_add * 1e6);
+
+    start = bench_now();
+    for (i = 0; i < LOOKUPS; i++)
+        found += buf_hash_lookup(h, keys[rand() % SESSIONS]) != NULL;
+    printf("%-8s lookup %10.1f ns\n", name,
+           (bench_now() - start) * 1e9 / LOOKUPS);
+
+    if (found != LOOKUPS)
+        printf("%s: wrong result\n", name);
+    hash_destroy(h);
+}
+
+int main(void)
+{
+    char id[64];
+    uint i;
+
+    for (i = 0; i < SESSIONS; i++) {
+        snprintf(id, sizeof id, "session-%08x-%u", rand(), i);
+        sessions[i] = (struct session *)kzref_alloc(sizeof *sessions[i],
+                                                    session_destructor);
+        sessions[i]->id = buf_strdub(id);
+        keys[i] = buf_strdub(id);
+    }
+
+    bench_list();
+    bench_hash("wyhash", hash_wyhash);
+    bench_hash("fnv1a", hash_fnv1a);
+
+    for (i = 0; i < SESSIONS; i++) {
+        kmem_deref(sessions + i);
+        buf_deref(keys + i);
+    }
+    return 0;
+}
@@ -0,0 +1,113 @@
+/*
+ * Contended kmem_ref()/kmem_deref() throughput:
+ * plain refcount serialized by a mutex versus KRALLOC_ATOMIC_REF
+ * and handed off KRALLOC_BIASED_REF, plus uncontended cost of
+ * every mode for the allocating thread
+ */
+#include "kref_alloc.h"
+#include "bench.h"
+#include <pthread.h>
+#include <stdlib.h>
+
+#define ITERATIONS 2000000
+
+static void *shared_mem;
+static pthread_mutex_t shared_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void *mutex_worker(void *arg)
+{
+    void *mem;
+    int i;
+    UNUSED(arg);
+
+    for (i = 0; i < ITERATIONS; i++) {
+        pthread_mutex_lock(&shared_lock);
+        mem = kmem_ref(shared_mem);
+        pthread_mutex_unlock(&shared_lock);
+
+        pthread_mutex_lock(&shared_lock);
+        kmem_deref(&mem);
+        pthread_mutex_unlock(&shared_lock);
+    }
+    return NULL;
+}
+
+static void *atomic_worker(void *arg)
+{
+    void *mem;
+    int i;
+    UNUSED(arg);
+
+    for (i = 0; i < ITERATIONS; i++) {
+        mem = kmem_ref(shared_mem);
+        kmem_deref(&mem);
+    }
+    return NULL;
+}
+
+static double run(void *(*worker)(void *), int nr_threads)
+{
+    pthread_t threads[64];
+    double start;
+    int i;
+
+    start = bench_now();
+    for (i = 0; i < nr_threads; i++)
+        pthread_create(threads + i, NULL, worker, NULL);
+    for (i = 0; i < nr_threads; i++)
+        pthread_join(threads[i], NULL);
+    return (double)nr_threads * ITERATIONS / (bench_now() - start);
+}
+
+static double run_owner(uint flags)
+{
+    void *mem;
+    double start;
+    int i;
+
+    kref_alloc_init(flags);
+    shared_mem = kref_alloc(64, NULL);
+    start = bench_now();
+    for (i = 0; i < ITERATIONS; i++) {
+        mem = kmem_ref(shared_mem);
+        kmem_deref(&mem);
+    }
+    start = bench_now() - start;
+    kmem_deref(&shared_mem);
+    return start * 1e9 / ITERATIONS;
+}
+
+int main(void)
+{
+    int nr_threads[] = {1, 2, 4, 8};
+    double mutex_ops, atomic_ops, biased_ops;
+    uint i;
+
+    bench_check_cpus();
+    printf("owner thread ref+deref: plain %.2f ns, atomic %.2f ns, biased %.2f ns\n\n",
+           run_owner(0), run_owner(KRALLOC_ATOMIC_REF),
+           run_owner(KRALLOC_BIASED_REF));
+
+    printf("%-8s %16s %16s %16s\n", "threads", "mutex ref/s",
+           "atomic ref/s", "biased ref/s");
+    for (i = 0; i < sizeof nr_threads / sizeof nr_threads[0]; i++) {
+        kref_alloc_init(0);
+        shared_mem = kref_alloc(64, NULL);
+        mutex_ops = run(mutex_worker, nr_threads[i]);
+        kmem_deref(&shared_mem);
+
+        kref_alloc_init(KRALLOC_ATOMIC_REF);
+        shared_mem = kref_alloc(64, NULL);
+        atomic_ops = run(atomic_worker, nr_threads[i]);
+        kmem_deref(&shared_mem);
+
+        kref_alloc_init(KRALLOC_BIASED_REF);
+        shared_mem = kmem_handoff(kref_alloc(64, NULL));
+        biased_ops = run(atomic_worker, nr_threads[i]);
+        kmem_deref(&shared_mem);
+
+        printf("%-8d %16.0f %16.0f %16.0f\n", nr_threads[i],
+               mutex_ops, atomic_ops, biased_ops);
+    }
+    return 0;
+}
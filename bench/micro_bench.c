@@ -0,0 +1,319 @@
+/*
+ * Microbenchmarks of the whole library: allocation at many sizes and
+ * alignments, references, tree teardown, lists, buffers and strings.
+ * Reports ns/op and kref allocations/bytes per op for malloc and slab
+ * backends, '--json' prints results for tracking over time.
+ *   micro_bench [--json] [--time SEC] [filter]
+ */
+#include "buf.h"
+#include "kstat.h"
+#include "bench.h"
+#include <stdlib.h>
+
+/* operations of one measurement are sized to run at least that long */
+static double min_time = 0.2;
+
+/* operations used to count allocations */
+#define COUNT_OPS 1000
+
+struct bench_case {
+    const char *name;
+    uint arg;
+    void (*run)(uint arg, uint n);
+};
+
+struct bench_result {
+    const char *backend;
+    const struct bench_case *c;
+    ulong ops;
+    double ns_per_op;
+    double allocs_per_op;
+    double bytes_per_op;
+};
+
+static void *sink;
+
+
+static void run_kref_alloc(uint size, uint n)
+{
+    void *mem;
+
+    while (n--) {
+        mem = kref_alloc(size, NULL);
+        sink = mem;
+        kmem_deref(&mem);
+    }
+}
+
+static void run_kzref_alloc(uint size, uint n)
+{
+    void *mem;
+
+    while (n--) {
+        mem = kzref_alloc(size, NULL);
+        sink = mem;
+        kmem_deref(&mem);
+    }
+}
+
+static void run_kref_alloc_aligned(uint align, uint n)
+{
+    void *mem;
+
+    while (n--) {
+        mem = kref_alloc_aligned(64, align, NULL);
+        sink = mem;
+        kmem_deref(&mem);
+    }
+}
+
+static void run_kmem_ref(uint arg, uint n)
+{
+    void *mem = kref_alloc(64, NULL), *ref;
+    UNUSED(arg);
+
+    while (n--) {
+        ref = kmem_ref(mem);
+        kmem_deref(&ref);
+    }
+    kmem_deref(&mem);
+}
+
+/* one op builds and tears down a tree of 'nr' children */
+static void run_tree(uint nr, uint n)
+{
+    void *root, *child;
+    uint i;
+
+    while (n--) {
+        root = kref_alloc(64, NULL);
+        for (i = 0; i < nr; i++) {
+            child = kref_alloc(32, NULL);
+            kmem_link_to_kmem(child, root);
+        }
+        kmem_deref(&root);
+    }
+}
+
+static void run_list_append_unlink(uint arg, uint n)
+{
+    struct list list = LIST_INIT;
+    struct le le = LE_INIT;
+    UNUSED(arg);
+
+    while (n--) {
+        list_append(&list, &le, &le);
+        list_unlink(&le);
+    }
+}
+
+static void run_list_count(uint nr, uint n)
+{
+    struct list list = LIST_INIT;
+    struct le *les = (struct le *)calloc(nr, sizeof *les);
+    uint i;
+    int cnt = 0;
+
+    for (i = 0; i < nr; i++)
+        list_append(&list, les + i, les + i);
+    while (n--)
+        cnt += list_count(&list);
+    sink = (void *)(ulong)cnt;
+    list_clear(&list);
+    free(les);
+}
+
+static struct buf *make_csv(uint len)
+{
+    struct buf *buf = buf_alloc(len);
+    uint i;
+
+    for (i = 0; i < len; i++)
+        buf->data[i] = i % 12 == 11 ? ',' : 'a' + i % 26;
+    return buf;
+}
+
+static void run_buf_split(uint len, uint n)
+{
+    struct buf *buf = make_csv(len);
+    struct list *parts;
+
+    while (n--) {
+        parts = buf_split(buf, ',');
+        list_destroy(parts);
+    }
+    buf_deref(&buf);
+}
+
+static void run_buf_split_view(uint len, uint n)
+{
+    struct buf *buf = make_csv(len);
+    struct list *parts;
+
+    while (n--) {
+        parts = buf_split_view(buf, ',');
+        list_destroy(parts);
+    }
+    buf_deref(&buf);
+}
+
+static void run_buf_trim(uint len, uint n)
+{
+    struct buf *buf = buf_alloc(len), *trimmed;
+
+    memset(buf->data, ' ', len);
+    memset(buf->data + len / 4, 'x', len / 2);
+    while (n--) {
+        trimmed = buf_trim(buf);
+        buf_deref(&trimmed);
+    }
+    buf_deref(&buf);
+}
+
+static void run_buf_concatenate(uint len, uint n)
+{
+    struct buf *b1 = make_csv(len), *b2 = make_csv(len), *res;
+
+    while (n--) {
+        res = (struct buf *)buf_concatenate(b1, b2);
+        buf_deref(&res);
+    }
+    buf_deref(&b1);
+    buf_deref(&b2);
+}
+
+static void run_kref_sprintf(uint arg, uint n)
+{
+    char *str;
+    UNUSED(arg);
+
+    while (n--) {
+        str = kref_sprintf("%s-%u:%08x", "request", n, n * 2654435761u);
+        kmem_deref(&str);
+    }
+}
+
+static const struct bench_case cases[] = {
+    {"kref_alloc", 16, run_kref_alloc},
+    {"kref_alloc", 64, run_kref_alloc},
+    {"kref_alloc", 256, run_kref_alloc},
+    {"kref_alloc", 1024, run_kref_alloc},
+    {"kref_alloc", 4096, run_kref_alloc},
+    {"kref_alloc", 65536, run_kref_alloc},
+    {"kzref_alloc", 64, run_kzref_alloc},
+    {"kzref_alloc", 4096, run_kzref_alloc},
+    {"kref_alloc_aligned", 16, run_kref_alloc_aligned},
+    {"kref_alloc_aligned", 64, run_kref_alloc_aligned},
+    {"kref_alloc_aligned", 128, run_kref_alloc_aligned},
+    {"kmem_ref_deref", 0, run_kmem_ref},
+    {"tree_teardown", 8, run_tree},
+    {"tree_teardown", 256, run_tree},
+    {"list_append_unlink", 0, run_list_append_unlink},
+    {"list_count", 16, run_list_count},
+    {"list_count", 1024, run_list_count},
+    {"buf_split", 4096, run_buf_split},
+    {"buf_split_view", 4096, run_buf_split_view},
+    {"buf_trim", 256, run_buf_trim},
+    {"buf_concatenate", 1024, run_buf_concatenate},
+    {"kref_sprintf", 0, run_kref_sprintf},
+};
+
+
+static void measure(const struct bench_case *c, uint flags,
+                    struct bench_result *r)
+{
+    struct kstat_counters before, after;
+    double start, elapsed;
+    ulong n = 16;
+
+    kref_alloc_init(flags);
+    c->run(c->arg, n); /* warm up caches */
+    for (;;) {
+        start = bench_now();
+        c->run(c->arg, n);
+        elapsed = bench_now() - start;
+        if (elapsed >= min_time || n >= (1UL << 30))
+            break;
+        n = elapsed > min_time / 100 ? n * min_time * 1.2 / elapsed : n * 10;
+    }
+    r->ops = n;
+    r->ns_per_op = elapsed * 1e9 / n;
+
+    /* counting pass, stats are off while timing */
+    kref_alloc_init(flags | KRALLOC_STATS);
+    kstat_get_total(&before);
+    c->run(c->arg, COUNT_OPS);
+    kstat_get_total(&after);
+    kref_alloc_init(flags);
+
+    r->allocs_per_op = (double)(after.allocs - before.allocs) / COUNT_OPS;
+    r->bytes_per_op = (double)(after.alloc_bytes - before.alloc_bytes) /
+                      COUNT_OPS;
+}
+
+
+static void print_json(struct bench_result *res, uint nr)
+{
+    uint i;
+
+    printf("{\n  \"benchmarks\": [\n");
+    for (i = 0; i < nr; i++)
+        printf("    {\"name\": \"%s/%u\", \"backend\": \"%s\", "
+               "\"iterations\": %lu, \"ns_per_op\": %.2f, "
+               "\"allocs_per_op\": %.2f, \"bytes_per_op\": %.1f}%s\n",
+               res[i].c->name, res[i].c->arg, res[i].backend, res[i].ops,
+               res[i].ns_per_op, res[i].allocs_per_op, res[i].bytes_per_op,
+               i + 1 < nr ? "," : "");
+    printf("  ]\n}\n");
+}
+
+
+int main(int argc, char **argv)
+{
+    static const struct {
+        const char *name;
+        uint flags;
+    } backends[] = {
+        {"malloc", 0},
+        {"slab", KRALLOC_SLAB},
+    };
+    struct bench_result res[2 * sizeof cases / sizeof cases[0]];
+    const char *filter = NULL;
+    char name[64];
+    bool json = FALSE;
+    uint i, b, nr = 0;
+
+    for (i = 1; i < (uint)argc; i++) {
+        if (!strcmp(argv[i], "--json"))
+            json = TRUE;
+        else if (!strcmp(argv[i], "--time") && i + 1 < (uint)argc)
+            min_time = atof(argv[++i]);
+        else
+            filter = argv[i];
+    }
+
+    if (!json)
+        printf("%-26s %-7s %12s %10s %10s\n", "benchmark", "backend",
+               "ns/op", "allocs/op", "bytes/op");
+
+    for (i = 0; i < sizeof cases / sizeof cases[0]; i++) {
+        snprintf(name, sizeof name, "%s/%u", cases[i].name, cases[i].arg);
+        if (filter && !strstr(name, filter))
+            continue;
+
+        for (b = 0; b < sizeof backends / sizeof backends[0]; b++) {
+            res[nr].backend = backends[b].name;
+            res[nr].c = cases + i;
+            measure(cases + i, backends[b].flags, res + nr);
+            if (!json)
+                printf("%-26s %-7s %12.1f %10.2f %10.1f\n", name,
+                       res[nr].backend, res[nr].ns_per_op,
+                       res[nr].allocs_per_op, res[nr].bytes_per_op);
+            nr++;
+        }
+    }
+
+    if (json)
+        print_json(res, nr);
+    return 0;
+}
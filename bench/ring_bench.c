@@ -0,0 +1,188 @@
+/*
+ * Hand-off of buf pointers between threads:
+ * mutex protected struct list versus lock-free SPSC and MPMC
+ * rings, single and batched operations
+ */
+#include "buf.h"
+#include "ring.h"
+#include "bench.h"
+#include <pthread.h>
+#include <sched.h>
+
+#ifndef MESSAGES
+#define MESSAGES 2000000
+#endif
+#define RING_SIZE 1024
+#define BATCH 32
+#define MAX_PAIRS 4
+#define POOL_SIZE (RING_SIZE * 2)
+
+/*
+ * Every producer reuses own pool of messages,
+ * at most RING_SIZE of them are in flight
+ */
+static struct buf *msgs[MAX_PAIRS][POOL_SIZE];
+
+static struct list list = LIST_INIT;
+static uint list_len;
+static pthread_mutex_t list_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct ring_spsc *spsc;
+static struct ring_mpmc *mpmc;
+static uint batch;
+static uint per_thread;
+
+static void *list_producer(void *arg)
+{
+    struct buf **pool = msgs[(ulong)arg];
+    uint i;
+
+    for (i = 0; i < per_thread; i++) {
+        for (;;) {
+            pthread_mutex_lock(&list_lock);
+            if (list_len < RING_SIZE)
+                break;
+            pthread_mutex_unlock(&list_lock);
+            sched_yield();
+        }
+        buf_list_append(&list, pool[i % POOL_SIZE]);
+        list_len++;
+        pthread_mutex_unlock(&list_lock);
+    }
+    return NULL;
+}
+
+static void *list_consumer(void *arg)
+{
+    uint i = 0;
+    struct le *le;
+    UNUSED(arg);
+
+    while (i < per_thread) {
+        pthread_mutex_lock(&list_lock);
+        le = list_head(&list);
+        if (le) {
+            list_unlink(le);
+            list_len--;
+            i++;
+        }
+        pthread_mutex_unlock(&list_lock);
+        if (!le)
+            sched_yield();
+    }
+    return NULL;
+}
+
+static void *spsc_producer(void *arg)
+{
+    void **pool = (void **)msgs[(ulong)arg];
+    uint i, n;
+
+    for (i = 0; i < per_thread; i += n) {
+        n = MIN(batch, per_thread - i);
+        n = MIN(n, POOL_SIZE - i % POOL_SIZE);
+        n = ring_spsc_enqueue_bulk(spsc, pool + i % POOL_SIZE, n);
+        if (!n)
+            sched_yield();
+    }
+    return NULL;
+}
+
+static void *spsc_consumer(void *arg)
+{
+    void *out[BATCH];
+    uint i, n;
+    UNUSED(arg);
+
+    for (i = 0; i < per_thread; i += n) {
+        n = ring_spsc_dequeue_bulk(spsc, out, MIN(batch, per_thread - i));
+        if (!n)
+            sched_yield();
+    }
+    return NULL;
+}
+
+static void *mpmc_producer(void *arg)
+{
+    void **pool = (void **)msgs[(ulong)arg];
+    uint i, n;
+
+    for (i = 0; i < per_thread; i += n) {
+        n = MIN(batch, per_thread - i);
+        n = MIN(n, POOL_SIZE - i % POOL_SIZE);
+        n = ring_mpmc_enqueue_bulk(mpmc, pool + i % POOL_SIZE, n);
+        if (!n)
+            sched_yield();
+    }
+    return NULL;
+}
+
+static void *mpmc_consumer(void *arg)
+{
+    void *out[BATCH];
+    uint i, n;
+    UNUSED(arg);
+
+    for (i = 0; i < per_thread; i += n) {
+        n = ring_mpmc_dequeue_bulk(mpmc, out, MIN(batch, per_thread - i));
+        if (!n)
+            sched_yield();
+    }
+    return NULL;
+}
+
+static void run(const char *name, void *(*producer)(void *),
+                void *(*consumer)(void *), int nr_pairs, uint batch_size)
+{
+    pthread_t threads[16];
+    double start, elapsed;
+    long i;
+
+    batch = batch_size;
+    per_thread = MESSAGES / nr_pairs;
+
+    start = bench_now();
+    for (i = 0; i < nr_pairs; i++) {
+        pthread_create(threads + 2 * i, NULL, producer, (void *)i);
+        pthread_create(threads + 2 * i + 1, NULL, consumer, (void *)i);
+    }
+    for (i = 0; i < 2 * nr_pairs; i++)
+        pthread_join(threads[i], NULL);
+    elapsed = bench_now() - start;
+
+    printf("%-8s %dP/%dC batch %2u: %8.2f Mmsg/s\n", name, nr_pairs, nr_pairs,
+           batch_size, (double)per_thread * nr_pairs / elapsed / 1e6);
+}
+
+int main(void)
+{
+    int i, j;
+
+    bench_check_cpus();
+    for (i = 0; i < MAX_PAIRS; i++)
+        for (j = 0; j < POOL_SIZE; j++)
+            msgs[i][j] = buf_alloc(64);
+
+    /* byte size of these doesn't fit kref_alloc_aligned() int size */
+    if (ring_spsc_create(1U << 28) || ring_mpmc_create(1U << 27))
+        printf("oversized ring: wrong result\n");
+
+    spsc = ring_spsc_create(RING_SIZE);
+    mpmc = ring_mpmc_create(RING_SIZE);
+
+    run("list", list_producer, list_consumer, 1, 1);
+    run("spsc", spsc_producer, spsc_consumer, 1, 1);
+    run("spsc", spsc_producer, spsc_consumer, 1, BATCH);
+    run("mpmc", mpmc_producer, mpmc_consumer, 1, 1);
+    run("mpmc", mpmc_producer, mpmc_consumer, 1, BATCH);
+    run("list", list_producer, list_consumer, 4, 1);
+    run("mpmc", mpmc_producer, mpmc_consumer, 4, 1);
+    run("mpmc", mpmc_producer, mpmc_consumer, 4, BATCH);
+
+    kmem_deref(&spsc);
+    kmem_deref(&mpmc);
+    for (i = 0; i < MAX_PAIRS; i++)
+        for (j = 0; j < POOL_SIZE; j++)
+            kmem_deref(&msgs[i][j]);
+    return 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * Separator search throughput on large CSV-like input:
+ * byte-by-byte loop versus buf_scan_any() kernel, and full
+ * buf_split() family including building the parts list
+ */
+#include "buf.h"
+#include "buf_scan.h"
+#include "bench.h"
+#include <stdlib.h>
+
+#define INPUT_SIZE (8 << 20)
+#define SCAN_ROUNDS 16
+
+static struct buf *make_input(void)
+{
+    struct buf *buf = buf_alloc(INPUT_SIZE);
+    uint i = 0, field;
+
+    srand(1);
+    while (i < INPUT_SIZE) {
+        for (field = 8 + rand() % 40; field-- && i < INPUT_SIZE; i++)
+            buf->data[i] = 'a' + rand() % 26;
+        if (i < INPUT_SIZE - 2) {
+            if (rand() % 8)
+                buf->data[i++] = rand() % 2 ? ',' : ';';
+            else {
+                buf->data[i++] = '\r';
+                buf->data[i++] = '\n';
+            }
+        }
+    }
+    return buf;
+}
+
+/* separator search as buf_split() did it before the kernels */
+static const u8 *find_bytewise(const u8 *p, const u8 *end, const u8 *seps)
+{
+    for (; p < end; p++)
+        if (*p == seps[0] || *p == seps[1])
+            return p;
+    return NULL;
+}
+
+static uint count_bytewise(const u8 *p, uint len, const u8 *seps)
+{
+    const u8 *end = p + len;
+    uint cnt = 0;
+
+    while ((p = find_bytewise(p, end, seps))) {
+        cnt++;
+        p++;
+    }
+    return cnt;
+}
+
+static uint count_kernel(const u8 *p, uint len, const u8 *seps)
+{
+    const u8 *end = p + len;
+    uint cnt = 0;
+
+    while ((p = buf_scan_any(p, end - p, seps, 2))) {
+        cnt++;
+        p++;
+    }
+    return cnt;
+}
+
+static void report(const char *name, double time, uint bytes, uint cnt)
+{
+    printf("%-24s %6.2f GB/s  (%u matches)\n", name, bytes / time / 1e9, cnt);
+}
+
+static void bench_split(const char *name, struct buf *input,
+                        struct list *(*split)(struct buf *, const char *),
+                        const char *sep)
+{
+    struct list *list;
+    double start = bench_now();
+
+    list = split(input, sep);
+    report(name, bench_now() - start, INPUT_SIZE, list_count(list));
+    list_destroy(list);
+}
+
+static struct list *split_byte(struct buf *buf, const char *sep)
+{
+    return buf_split(buf, sep[0]);
+}
+
+static struct list *split_byte_view(struct buf *buf, const char *sep)
+{
+    return buf_split_view(buf, sep[0]);
+}
+
+int main(void)
+{
+    struct buf *input = make_input();
+    const u8 seps[] = ",;";
+    const u8 sparse_seps[] = "|\n";
+    double start;
+    uint i, cnt = 0;
+
+    printf("kernel: %s, input %u MB\n", buf_scan_kernel(), INPUT_SIZE >> 20);
+
+    start = bench_now();
+    for (i = 0; i < SCAN_ROUNDS; i++)
+        cnt = count_bytewise(input->data, INPUT_SIZE, seps);
+    report("scan ',;' bytewise", bench_now() - start, INPUT_SIZE * SCAN_ROUNDS, cnt);
+
+    start = bench_now();
+    for (i = 0; i < SCAN_ROUNDS; i++)
+        cnt = count_kernel(input->data, INPUT_SIZE, seps);
+    report("scan ',;' kernel", bench_now() - start, INPUT_SIZE * SCAN_ROUNDS, cnt);
+
+    start = bench_now();
+    for (i = 0; i < SCAN_ROUNDS; i++)
+        cnt = count_bytewise(input->data, INPUT_SIZE, sparse_seps);
+    report("scan '|\\n' bytewise", bench_now() - start, INPUT_SIZE * SCAN_ROUNDS, cnt);
+
+    start = bench_now();
+    for (i = 0; i < SCAN_ROUNDS; i++)
+        cnt = count_kernel(input->data, INPUT_SIZE, sparse_seps);
+    report("scan '|\\n' kernel", bench_now() - start, INPUT_SIZE * SCAN_ROUNDS, cnt);
+
+    bench_split("buf_split ','", input, split_byte, ",");
+    bench_split("buf_split_view ','", input, split_byte_view, ",");
+    bench_split("buf_split_any_view ',;'", input, buf_split_any_view, ",;");
+    bench_split("buf_split_str_view CRLF", input, buf_split_str_view, "\r\n");
+
+    buf_deref(&input);
+    return 0;
+}
@@ -0,0 +1,404 @@
+/*
+ * Replay of allocation trace recorded with KRALLOC_TRACE against
+ * libc malloc and kref backends, every backend runs in own process.
+ * Reports throughput, peak RSS and fragmentation: resident bytes
+ * above start per live requested byte at the moment of peak usage.
+ *   trace_replay [trace file]
+ * Without arguments records and replays a synthetic workload.
+ */
+#include "kref_alloc.h"
+#include "ktrace.h"
+#include "bench.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#define SYNTH_OPS 400000
+#define SYNTH_THREADS 2
+
+/** Trace converted to object slots */
+struct replay_op {
+    u32 slot;
+    u32 size;       /* 0 for free */
+    u8 align_order;
+};
+
+struct replay {
+    struct replay_op *ops;
+    ulong nr_ops;
+    ulong nr_slots;
+    ulong peak_op;              /* op index where live bytes are highest */
+    unsigned long long peak_live;
+    ulong nr_dups;              /* allocs of address that was still live */
+};
+
+struct replay_result {
+    double seconds;
+    long start_rss;
+    long peak_rss;              /* ru_maxrss */
+    long rss_at_peak;
+};
+
+static long resident_bytes(void)
+{
+    long size, resident = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+
+    if (!f)
+        return 0;
+    if (fscanf(f, "%ld %ld", &size, &resident) != 2)
+        resident = 0;
+    fclose(f);
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+/* records sorted by rec_cmp(), qsort() passes no context */
+static const struct ktrace_rec *sort_recs;
+
+/*
+ * Order record indexes by timestamp, then thread and file position,
+ * so that records of one thread with equal timestamps keep their order
+ */
+static int rec_cmp(const void *p1, const void *p2)
+{
+    ulong i1 = *(const ulong *)p1, i2 = *(const ulong *)p2;
+    const struct ktrace_rec *r1 = sort_recs + i1, *r2 = sort_recs + i2;
+
+    if (r1->ts != r2->ts)
+        return r1->ts < r2->ts ? -1 : 1;
+    if (r1->thread != r2->thread)
+        return r1->thread < r2->thread ? -1 : 1;
+    return i1 < i2 ? -1 : i1 > i2;
+}
+
+/* open addressing map of live addresses to slots */
+struct slot_map {
+    unsigned long long *addrs;
+    u32 *slots;
+    ulong mask;
+};
+
+static ulong map_find(struct slot_map *m, unsigned long long addr)
+{
+    ulong i = (addr >> 4) * 0x9e3779b97f4a7c15ULL & m->mask;
+
+    while (m->addrs[i] && m->addrs[i] != addr)
+        i = (i + 1) & m->mask;
+    return i;
+}
+
+static void map_remove(struct slot_map *m, ulong i)
+{
+    ulong j = i, k;
+
+    /* backward shift deletion keeps probe chains intact */
+    m->addrs[i] = 0;
+    for (;;) {
+        j = (j + 1) & m->mask;
+        if (!m->addrs[j])
+            return;
+        k = (m->addrs[j] >> 4) * 0x9e3779b97f4a7c15ULL & m->mask;
+        if ((j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j))) {
+            m->addrs[i] = m->addrs[j];
+            m->slots[i] = m->slots[j];
+            m->addrs[j] = 0;
+            i = j;
+        }
+    }
+}
+
+static int load_trace(const char *path, struct replay *r)
+{
+    struct ktrace_header hdr;
+    struct ktrace_rec *recs = NULL, *rec;
+    struct slot_map map = {NULL, NULL, 0};
+    unsigned long long live = 0;
+    ulong nr, i, m, n = 0;
+    ulong *order = NULL;
+    u32 *sizes = NULL;
+    int rc = -1;
+    FILE *f = fopen(path, "r");
+
+    r->ops = NULL;
+    if (!f) {
+        fprintf(stderr, "can't open %s\n", path);
+        return -1;
+    }
+    if (fread(&hdr, sizeof hdr, 1, f) != 1 ||
+        hdr.magic != KTRACE_MAGIC || hdr.version != KTRACE_VERSION ||
+        hdr.rec_size != sizeof *recs) {
+        fprintf(stderr, "%s is not a kmem trace\n", path);
+        fclose(f);
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    nr = (ftell(f) - sizeof hdr) / sizeof *recs;
+    fseek(f, sizeof hdr, SEEK_SET);
+    recs = (struct ktrace_rec *)malloc(nr * sizeof *recs + 1);
+    if (!recs) {
+        fclose(f);
+        goto nomem;
+    }
+    nr = fread(recs, sizeof *recs, nr, f);
+    fclose(f);
+
+    /* per thread buffers are written in chunks, restore global order */
+    order = (ulong *)malloc((nr + 1) * sizeof *order);
+    if (!order)
+        goto nomem;
+    for (i = 0; i < nr; i++)
+        order[i] = i;
+    sort_recs = recs;
+    qsort(order, nr, sizeof *order, rec_cmp);
+
+    for (m = 1; m < 2 * nr + 2; m <<= 1);
+    map.addrs = (unsigned long long *)calloc(m, sizeof *map.addrs);
+    map.slots = (u32 *)calloc(m, sizeof *map.slots);
+    map.mask = m - 1;
+    /* every alloc can be preceded by synthetic free */
+    r->ops = (struct replay_op *)malloc((2 * nr + 1) * sizeof *r->ops);
+    sizes = (u32 *)malloc((nr + 1) * sizeof *sizes);
+    if (!map.addrs || !map.slots || !r->ops || !sizes)
+        goto nomem;
+    r->nr_slots = 0;
+    r->peak_live = 0;
+    r->peak_op = 0;
+    r->nr_dups = 0;
+
+    for (i = 0; i < nr; i++) {
+        ulong pos;
+
+        rec = recs + order[i];
+        pos = map_find(&map, rec->addr);
+        if (rec->type == KTRACE_ALLOC) {
+            if (map.addrs[pos]) {
+                /* free of live address is lost, release it here */
+                r->ops[n].slot = map.slots[pos];
+                r->ops[n].size = 0;
+                live -= sizes[map.slots[pos]];
+                r->nr_dups++;
+                n++;
+            }
+            map.addrs[pos] = rec->addr;
+            map.slots[pos] = r->nr_slots;
+            sizes[r->nr_slots] = rec->size;
+            r->ops[n].slot = r->nr_slots++;
+            r->ops[n].size = rec->size ? rec->size : 1;
+            r->ops[n].align_order = rec->align_order;
+            live += rec->size;
+            if (live > r->peak_live) {
+                r->peak_live = live;
+                r->peak_op = n;
+            }
+            n++;
+        } else if (map.addrs[pos]) {
+            /* memories allocated before recording are skipped */
+            r->ops[n].slot = map.slots[pos];
+            r->ops[n].size = 0;
+            live -= sizes[map.slots[pos]];
+            map_remove(&map, pos);
+            n++;
+        }
+    }
+    r->nr_ops = n;
+    rc = 0;
+    goto out;
+
+nomem:
+    fprintf(stderr, "not enough memory to load %s\n", path);
+    free(r->ops);
+    r->ops = NULL;
+out:
+    free(order);
+    free(sizes);
+    free(map.addrs);
+    free(map.slots);
+    free(recs);
+    return rc;
+}
+
+static void touch(u8 *p, uint size)
+{
+    uint i;
+
+    for (i = 0; i < size; i += 4096)
+        p[i] = (u8)i;
+}
+
+static int replay_run(struct replay *r, int use_kref, uint flags,
+                      struct replay_result *res)
+{
+    void **slots = (void **)calloc(r->nr_slots + 1, sizeof(void *));
+    struct replay_op *op;
+    struct rusage ru;
+    double start;
+    uint align;
+    ulong i;
+
+    if (!slots)
+        return -1;
+
+    kref_alloc_init(flags);
+#ifdef __GLIBC__
+    /* memory freed while loading trace must not be reused unnoticed */
+    malloc_trim(0);
+#endif
+    res->start_rss = resident_bytes();
+    res->rss_at_peak = 0;
+
+    start = bench_now();
+    for (i = 0; i < r->nr_ops; i++) {
+        op = r->ops + i;
+        if (op->size) {
+            align = op->align_order ? 1U << (op->align_order - 1) : 0;
+            if (use_kref)
+                slots[op->slot] = kref_alloc_aligned(op->size, align, NULL);
+            else if (align > sizeof(void *) &&
+                     posix_memalign(slots + op->slot, align, op->size))
+                slots[op->slot] = NULL;
+            else if (align <= sizeof(void *))
+                slots[op->slot] = malloc(op->size);
+            if (!slots[op->slot])
+                return -1;
+            touch((u8 *)slots[op->slot], op->size);
+        } else if (use_kref) {
+            kmem_deref(&slots[op->slot]);
+        } else {
+            free(slots[op->slot]);
+            slots[op->slot] = NULL;
+        }
+        if (i == r->peak_op)
+            res->rss_at_peak = resident_bytes();
+    }
+    res->seconds = bench_now() - start;
+
+    getrusage(RUSAGE_SELF, &ru);
+    res->peak_rss = ru.ru_maxrss * 1024L;
+    return 0;
+}
+
+static void replay_backend(struct replay *r, const char *name,
+                           int use_kref, uint flags)
+{
+    struct replay_result res;
+    int fds[2];
+    pid_t pid;
+
+    if (pipe(fds))
+        return;
+
+    pid = fork();
+    if (!pid) {
+        close(fds[0]);
+        if (replay_run(r, use_kref, flags, &res))
+            _exit(1);
+        if (write(fds[1], &res, sizeof res) != sizeof res)
+            _exit(1);
+        _exit(0);
+    }
+    close(fds[1]);
+    if (read(fds[0], &res, sizeof res) != sizeof res) {
+        fprintf(stderr, "%s replay failed\n", name);
+        res.seconds = 0;
+    }
+    close(fds[0]);
+    waitpid(pid, NULL, 0);
+    if (!res.seconds)
+        return;
+
+    printf("%-12s %10.2f Mops/s %10.1f MB %10.1f MB %8.2f\n", name,
+           r->nr_ops / res.seconds / 1e6, res.peak_rss / 1048576.0,
+           (res.rss_at_peak - res.start_rss) / 1048576.0,
+           r->peak_live ? (double)(res.rss_at_peak - res.start_rss) /
+                          r->peak_live : 0);
+}
+
+/* synthetic traffic: mostly small short lived objects, some
+ * long lived and some large buffers, two threads */
+static void *synth_worker(void *arg)
+{
+    void *live[4096];
+    uint i, size, seed = (uint)(ulong)arg + 1;
+
+    memset(live, 0, sizeof live);
+    for (i = 0; i < SYNTH_OPS / SYNTH_THREADS; i++) {
+        seed = seed * 1103515245 + 12345;
+        size = (seed >> 16) % 100 < 90 ? 16 + (seed >> 8) % 240 :
+               (seed >> 16) % 100 < 99 ? 256 + (seed >> 4) % 4096 :
+                                         65536 + (seed >> 4) % 262144;
+        kmem_deref(&live[(seed >> 3) % 4096]);
+        live[(seed >> 3) % 4096] = kref_alloc_aligned(size,
+                                        (seed >> 20) % 16 ? 0 : 64, NULL);
+    }
+    for (i = 0; i < 4096; i++)
+        kmem_deref(&live[i]);
+    return NULL;
+}
+
+static int record_synthetic(const char *path)
+{
+    pthread_t threads[SYNTH_THREADS];
+    int status;
+    long i;
+    pid_t pid;
+
+    /* recording process heap is not inherited by replays */
+    pid = fork();
+    if (pid) {
+        waitpid(pid, &status, 0);
+        return pid > 0 && WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    }
+
+    kref_alloc_init(KRALLOC_TRACE | KRALLOC_ATOMIC_REF);
+    if (ktrace_start(path))
+        _exit(1);
+    for (i = 0; i < SYNTH_THREADS; i++)
+        pthread_create(threads + i, NULL, synth_worker, (void *)i);
+    for (i = 0; i < SYNTH_THREADS; i++)
+        pthread_join(threads[i], NULL);
+    ktrace_stop();
+    _exit(0);
+}
+
+int main(int argc, char **argv)
+{
+    char synth_path[] = "/tmp/kmem_replay_XXXXXX";
+    const char *path = argv[1];
+    struct replay r;
+    int fd, rc;
+
+    if (argc < 2) {
+        fd = mkstemp(synth_path);
+        if (fd < 0)
+            return 1;
+        close(fd);
+        if (record_synthetic(synth_path))
+            return 1;
+        path = synth_path;
+    }
+
+    rc = load_trace(path, &r);
+    if (argc < 2)
+        unlink(synth_path);
+    if (rc)
+        return 1;
+
+    printf("%lu ops, %lu objects, peak live %.1f MB\n", r.nr_ops,
+           r.nr_slots, r.peak_live / 1048576.0);
+    if (r.nr_dups)
+        printf("%lu allocs of still live address, their frees are added\n",
+               r.nr_dups);
+    printf("%-12s %17s %13s %13s %8s\n", "backend", "throughput",
+           "peak RSS", "RSS at peak", "frag");
+    replay_backend(&r, "libc", FALSE, 0);
+    replay_backend(&r, "kref-malloc", TRUE, 0);
+    replay_backend(&r, "kref-slab", TRUE, KRALLOC_SLAB);
+    replay_backend(&r, "kref-huge", TRUE, KRALLOC_HUGE_PAGES);
+    free(r.ops);
+    return 0;
+}
@@ -0,0 +1,67 @@
+/*
+ * kmem_link_to_kmem() trees: linking, child ref/deref and teardown
+ * of wide trees (children of one root), deep trees (every node
+ * linked under the previous one) and merged subtrees
+ */
+#include "kref_alloc.h"
+#include "bench.h"
+#include <stdlib.h>
+
+#define NR_NODES 100000
+#define NR_SUBTREES 1000
+#define REF_ITERATIONS 1000000
+
+static void *nodes[NR_NODES];
+
+static void report(const char *name, double link_time, void *leaf, void *root)
+{
+    double ref_time, free_time;
+    void *mem;
+    int i;
+
+    ref_time = bench_now();
+    for (i = 0; i < REF_ITERATIONS; i++) {
+        mem = kmem_ref(leaf);
+        kmem_deref(&mem);
+    }
+    ref_time = bench_now() - ref_time;
+
+    free_time = bench_now();
+    kmem_deref(&root);
+    free_time = bench_now() - free_time;
+
+    printf("%-8s link %7.1f ns/node, leaf ref+deref %5.1f ns, teardown %6.1f ns/node\n",
+           name, link_time * 1e9 / NR_NODES, ref_time * 1e9 / REF_ITERATIONS,
+           free_time * 1e9 / NR_NODES);
+}
+
+int main(void)
+{
+    double start;
+    int i, j, per_tree = NR_NODES / NR_SUBTREES;
+
+    for (i = 0; i < NR_NODES; i++)
+        nodes[i] = kref_alloc(32, NULL);
+    start = bench_now();
+    for (i = 1; i < NR_NODES; i++)
+        kmem_link_to_kmem(nodes[i], nodes[0]);
+    report("wide", bench_now() - start, nodes[NR_NODES - 1], nodes[0]);
+
+    for (i = 0; i < NR_NODES; i++)
+        nodes[i] = kref_alloc(32, NULL);
+    start = bench_now();
+    for (i = 1; i < NR_NODES; i++)
+        kmem_link_to_kmem(nodes[i], nodes[i - 1]);
+    report("deep", bench_now() - start, nodes[NR_NODES - 1], nodes[0]);
+
+    for (i = 0; i < NR_NODES; i++)
+        nodes[i] = kref_alloc(32, NULL);
+    start = bench_now();
+    for (i = 0; i < NR_NODES; i += per_tree)
+        for (j = 1; j < per_tree; j++)
+            kmem_link_to_kmem(nodes[i + j], nodes[i]);
+    for (i = per_tree; i < NR_NODES; i += per_tree)
+        kmem_link_to_kmem(nodes[i], nodes[0]);
+    report("merged", bench_now() - start, nodes[NR_NODES - 1], nodes[0]);
+    return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * Buffer list of 100k elements: intrusive struct list versus
+ * unrolled ulist for append, iteration reading every buffer
+ * and removal of every second element while iterating.
+ * Buffers are linked in shuffled order like long living lists.
+ */
+#include "buf.h"
+#include "ulist.h"
+#include "bench.h"
+#include <stdlib.h>
+
+#ifndef ELEMENTS
+#define ELEMENTS 100000
+#endif
+#define ITER_ROUNDS 20
+
+static struct buf *bufs[ELEMENTS];
+
+static void report(const char *name, const char *op, double elapsed, uint n)
+{
+    printf("%-8s %-10s %8.2f ns/elem\n", name, op, elapsed * 1e9 / n);
+}
+
+static void bench_list(void)
+{
+    struct list *list = list_create();
+    struct le *le, *next_le;
+    struct buf *buf;
+    ulong sum = 0;
+    double start;
+    uint i, r, n = 0;
+
+    start = bench_now();
+    for (i = 0; i < ELEMENTS; i++) {
+        kmem_ref(bufs[i]);
+        buf_list_append(list, bufs[i]);
+    }
+    report("list", "append", bench_now() - start, ELEMENTS);
+
+    start = bench_now();
+    for (r = 0; r < ITER_ROUNDS; r++)
+        LIST_FOREACH(list, le) {
+            buf = (struct buf *)list_ledata(le);
+            sum += buf->len;
+        }
+    report("list", "iterate", bench_now() - start, ELEMENTS * ITER_ROUNDS);
+
+    start = bench_now();
+    LIST_FOREACH_SAFE(list, le, next_le) {
+        if (n++ % 2)
+            continue;
+        buf = (struct buf *)list_ledata(le);
+        list_unlink(le);
+        buf_deref(&buf);
+    }
+    report("list", "remove", bench_now() - start, ELEMENTS);
+
+    if (sum != (ulong)ELEMENTS * ITER_ROUNDS * 64 ||
+        list_count(list) != ELEMENTS / 2)
+        printf("list: wrong result\n");
+    list_destroy(list);
+}
+
+static void bench_ulist(void)
+{
+    struct ulist *ul = ulist_create();
+    struct ulist_iter it;
+    struct buf *buf;
+    ulong sum = 0;
+    double start;
+    uint i, r, n = 0;
+
+    start = bench_now();
+    for (i = 0; i < ELEMENTS; i++)
+        ulist_append(ul, kmem_ref(bufs[i]));
+    report("ulist", "append", bench_now() - start, ELEMENTS);
+
+    start = bench_now();
+    for (r = 0; r < ITER_ROUNDS; r++)
+        ULIST_FOREACH(ul, it, buf)
+            sum += buf->len;
+    report("ulist", "iterate", bench_now() - start, ELEMENTS * ITER_ROUNDS);
+
+    start = bench_now();
+    ULIST_FOREACH(ul, it, buf) {
+        if (n++ % 2)
+            continue;
+        buf = (struct buf *)ulist_remove(ul, &it);
+        buf_deref(&buf);
+    }
+    report("ulist", "remove", bench_now() - start, ELEMENTS);
+
+    if (sum != (ulong)ELEMENTS * ITER_ROUNDS * 64 ||
+        ulist_count(ul) != ELEMENTS / 2)
+        printf("ulist: wrong result\n");
+    ulist_destroy(ul);
+}
+
+int main(void)
+{
+    struct buf *tmp;
+    uint i, j;
+
+    for (i = 0; i < ELEMENTS; i++)
+        bufs[i] = buf_alloc(64);
+
+    srand(1);
+    for (i = ELEMENTS - 1; i > 0; i--) {
+        j = rand() % (i + 1);
+        tmp = bufs[i];
+        bufs[i] = bufs[j];
+        bufs[j] = tmp;
+    }
+
+    bench_list();
+    bench_ulist();
+
+    for (i = 0; i < ELEMENTS; i++)
+        buf_deref(bufs + i);
+    return 0;
+}
@@ -1,5 +1,24 @@
 #include "buf.h"
+#include "buf_scan.h"
 #include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/** Buffer sharing storage of parent buffer */
+struct buf_view {
+    struct buf buf;
+    struct buf *parent;
+};
+
+/** Buffer holding mapped file */
+struct buf_file {
+    struct buf buf;
+    size_t map_len;
+};
 
 static void buf_destructor(void *mem)
 {
@@ -7,6 +26,18 @@ static void buf_destructor(void *mem)
     memset(buf->data, 0, buf->len);
 }
 
+static void buf_view_destructor(void *mem)
+{
+    struct buf_view *view = (struct buf_view *)mem;
+    buf_deref(&view->parent);
+}
+
+static void buf_file_destructor(void *mem)
+{
+    struct buf_file *file = (struct buf_file *)mem;
+    munmap(file->buf.data, file->map_len);
+}
+
 struct buf *buf_alloc(uint size)
 {
     struct buf *buf = kzref_alloc(sizeof *buf + size, buf_destructor);
@@ -19,6 +50,84 @@ struct buf *buf_alloc(uint size)
     return buf;
 }
 
+/**
+ * Allocate buffer owning a region for memories linked to it,
+ * e.g. strings returned by buf_to_str()
+ */
+struct buf *buf_alloc_region(uint size, uint region_size)
+{
+    struct buf *buf = kref_alloc_region(sizeof *buf + size, region_size,
+                                        buf_destructor);
+    if (!buf)
+        return NULL;
+
+    memset(buf, 0, sizeof *buf + size);
+    buf->data = (u8 *)(buf + 1);
+    buf->len = size;
+    return buf;
+}
+
+/**
+ * Map file into buffer without reading it,
+ * pages are loaded on access and unmapped with the buffer
+ * @param path: file path
+ * @param flags: BUF_MMAP_* flags, read-only mapping by default
+ */
+struct buf *buf_mmap(const char *path, uint flags)
+{
+    struct buf_file *file;
+    struct stat st;
+    int fd, prot = PROT_READ;
+    u8 *data;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        print_e("can't open %s: %d\n", path, errno);
+        return NULL;
+    }
+
+    if (fstat(fd, &st)) {
+        print_e("can't stat %s: %d\n", path, errno);
+        close(fd);
+        return NULL;
+    }
+
+    if ((unsigned long long)st.st_size > UINT_MAX) {
+        print_e("%s is too big for buffer: %lld\n", path,
+                (long long)st.st_size);
+        close(fd);
+        return NULL;
+    }
+
+    if (!st.st_size) {
+        close(fd);
+        return buf_alloc(0);
+    }
+
+    if (flags & BUF_MMAP_PRIVATE)
+        prot |= PROT_WRITE;
+
+    data = mmap(NULL, st.st_size, prot, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        print_e("can't map %s: %d\n", path, errno);
+        return NULL;
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    file = (struct buf_file *)kzref_alloc(sizeof *file, buf_file_destructor);
+    if (!file) {
+        munmap(data, st.st_size);
+        return NULL;
+    }
+
+    file->map_len = st.st_size;
+    file->buf.data = data;
+    file->buf.len = st.st_size;
+    file->buf.payload_len = st.st_size;
+    return &file->buf;
+}
+
 struct buf *buf_strdub(const char *str)
 {
     uint len = strlen(str) + 1;
@@ -31,6 +140,10 @@ struct buf *buf_strdub(const char *str)
     return buf;
 }
 
+/**
+ * Concatenate two buffers into a new one by copying,
+ * see buf_cord_concatenate() for the zero-copy variant
+ */
 void *buf_concatenate(struct buf *b1, struct buf *b2)
 {
     struct buf *result;
@@ -118,6 +231,32 @@ void buf_list_dump(struct list *list)
 }
 
 
+/**
+ * Make buffer pointing into parent buffer data without copying.
+ * The view holds a reference to parent until it is released.
+ * @param parent: buffer to look into
+ * @param offset: view start in parent data
+ * @param len: view length
+ */
+struct buf *buf_view(struct buf *parent, uint offset, uint len)
+{
+    struct buf_view *view;
+
+    if (!parent || offset > parent->len || len > parent->len - offset)
+        return NULL;
+
+    view = (struct buf_view *)kzref_alloc(sizeof *view, buf_view_destructor);
+    if (!view)
+        return NULL;
+
+    view->parent = (struct buf *)kmem_ref(parent);
+    view->buf.data = parent->data + offset;
+    view->buf.len = len;
+    view->buf.payload_len = len;
+    return &view->buf;
+}
+
+
 struct buf *buf_cpy(void *src, uint len)
 {
     struct buf *buf = buf_alloc(len);
@@ -139,10 +278,9 @@ char *buf_to_str(struct buf *buf)
     if (!buf->data[buf->len - 1])
         return (char *)buf->data;
 
-    str = (char *)kref_alloc(buf->len + 1, NULL);
+    str = (char *)kref_alloc_in(buf, buf->len + 1, NULL);
     if (!str)
         return NULL;
-    kmem_link_to_kmem(str, buf);
     len = buf->payload_len ? buf->payload_len : buf->len;
     memcpy(str, buf->data, len);
     str[len] = 0;
@@ -156,13 +294,32 @@ void buf_put(struct buf *buf, uint payload_len)
     buf->payload_len = payload_len;
 }
 
-struct list *buf_split(struct buf *buf, char sep)
+/** Separator description for split functions */
+struct buf_sep {
+    const u8 *seps;
+    uint len;
+    bool is_set; /* any of seps bytes, otherwise one multi-byte separator */
+};
+
+/**
+ * Make list part either as copy or as view of buffer
+ */
+static struct buf *buf_part(struct buf *buf, const u8 *part, uint len, bool view)
 {
-    int len = buf->payload_len ? buf->payload_len : buf->len;
-    uint part_len = 0;
+    if (view)
+        return buf_view(buf, part - buf->data, len);
+    return buf_cpy((void *)part, len);
+}
+
+static struct list *buf_split_parts(struct buf *buf, const struct buf_sep *sep,
+                                    bool view)
+{
+    const u8 *part = buf->data;
+    const u8 *end = buf->data + buf_data_len(buf);
+    const u8 *found;
+    uint sep_len = sep->is_set ? 1 : sep->len;
     struct list *list;
     struct buf *part_buf;
-    int i;
 
     list = list_create();
     if (!list) {
@@ -170,37 +327,24 @@ struct list *buf_split(struct buf *buf, char sep)
         goto err;
     }
 
-    u8 *part = buf->data;
-    for (i = 0; i < len; i++) {
-        u8 *p = buf->data + i;
-        if (*p != sep) {
-            part_len ++;
-            continue;
-        }
-
-        if (!part_len) {
-            part_len = 0;
-            part = p + 1;
-            continue;
+    while (part < end) {
+        if (sep->is_set)
+            found = buf_scan_any(part, end - part, sep->seps, sep->len);
+        else
+            found = buf_scan_str(part, end - part, sep->seps, sep->len);
+        if (!found)
+            found = end;
+
+        /* empty parts are skipped */
+        if (found > part) {
+            part_buf = buf_part(buf, part, found - part, view);
+            if (!part_buf) {
+                print_e("Can't alloc buffer\n");
+                goto err;
+            }
+            buf_list_append(list, part_buf);
         }
-
-        part_buf = buf_cpy((void *)part, part_len);
-        if (!part_buf) {
-            print_e("Can't alloc buffer\n");
-            goto err;
-        }
-        buf_list_append(list, part_buf);
-        part_len = 0;
-        part = p + 1;
-    }
-
-    if (part_len) {
-        part_buf = buf_cpy((void *)part, part_len);
-        if (!part_buf) {
-            print_e("Can't alloc buffer\n");
-            goto err;
-        }
-        buf_list_append(list, part_buf);
+        part = found + sep_len;
     }
 
     kmem_ref(list);
@@ -209,6 +353,52 @@ err:
     return list;
 }
 
+struct list *buf_split(struct buf *buf, char sep)
+{
+    struct buf_sep s = {(const u8 *)&sep, 1, TRUE};
+    return buf_split_parts(buf, &s, FALSE);
+}
+
+/**
+ * Split buffer without copying, every part is
+ * a view holding a reference to the buffer
+ */
+struct list *buf_split_view(struct buf *buf, char sep)
+{
+    struct buf_sep s = {(const u8 *)&sep, 1, TRUE};
+    return buf_split_parts(buf, &s, TRUE);
+}
+
+/**
+ * Split buffer by any byte of separators set, e.g. ",;"
+ */
+struct list *buf_split_any(struct buf *buf, const char *seps)
+{
+    struct buf_sep s = {(const u8 *)seps, (uint)strlen(seps), TRUE};
+    return buf_split_parts(buf, &s, FALSE);
+}
+
+struct list *buf_split_any_view(struct buf *buf, const char *seps)
+{
+    struct buf_sep s = {(const u8 *)seps, (uint)strlen(seps), TRUE};
+    return buf_split_parts(buf, &s, TRUE);
+}
+
+/**
+ * Split buffer by multi-byte separator, e.g. "\r\n"
+ */
+struct list *buf_split_str(struct buf *buf, const char *sep)
+{
+    struct buf_sep s = {(const u8 *)sep, (uint)strlen(sep), FALSE};
+    return buf_split_parts(buf, &s, FALSE);
+}
+
+struct list *buf_split_str_view(struct buf *buf, const char *sep)
+{
+    struct buf_sep s = {(const u8 *)sep, (uint)strlen(sep), FALSE};
+    return buf_split_parts(buf, &s, TRUE);
+}
+
 struct buf *buf_trim(struct buf *buf)
 {
     uint len = buf->payload_len ? buf->payload_len : buf->len;
@@ -228,4 +418,21 @@ struct buf *buf_trim(struct buf *buf)
     new_buf = buf_cpy(start, new_len + 1);
     new_buf->data[new_len + 1] = 0;
     return new_buf;
-}
\ No newline at end of file
+}
+
+/**
+ * Trim spaces without copying
+ * @return view of buffer without leading and trailing spaces
+ */
+struct buf *buf_trim_view(struct buf *buf)
+{
+    u8 *start = buf->data;
+    u8 *end = buf->data + buf_data_len(buf);
+
+    while (start < end && isspace(*start))
+        start++;
+    while (end > start && isspace(end[-1]))
+        end--;
+
+    return buf_view(buf, start - buf->data, end - start);
+}
@@ -7,6 +7,10 @@ extern "C" {
 
 #include "kref_alloc.h"
 #include "list.h"
+#include "hash.h"
+
+/** buf_mmap() flags */
+#define BUF_MMAP_PRIVATE (1 << 0) /**< Writable copy-on-write mapping */
 
 struct buf {
     u8 *data;
@@ -16,7 +20,9 @@ struct buf {
 };
 
 struct buf *buf_alloc(uint size);
+struct buf *buf_alloc_region(uint size, uint region_size);
 struct buf *buf_strdub(const char *str);
+struct buf *buf_mmap(const char *path, uint flags);
 
 static inline struct buf *bufz_alloc(uint size)
 {
@@ -27,10 +33,38 @@ static inline struct buf *bufz_alloc(uint size)
     return buf;
 }
 
+/**
+ * Get length of data in buffer: payload length if set, buffer size otherwise
+ */
+static inline uint buf_data_len(const struct buf *buf)
+{
+    return buf->payload_len ? buf->payload_len : buf->len;
+}
+
 #define buf_list_append(list, buf) list_append(list, &buf->le, buf)
 
+/**
+ * Get buffer data as hash key, for hash_key_fn of objects keyed by buffer
+ */
+static inline const void *buf_key(const struct buf *buf, uint *len)
+{
+    *len = buf_data_len(buf);
+    return buf->data;
+}
+
+/**
+ * Find hash table element keyed by buffer contents
+ */
+static inline void *buf_hash_lookup(const struct hash *h, const struct buf *buf)
+{
+    uint len;
+    const void *key = buf_key(buf, &len);
+    return hash_lookup(h, key, len);
+}
+
 #define buf_deref(buf) kmem_deref(buf)
 struct buf *buf_cpy(void *src, uint len);
+struct buf *buf_view(struct buf *parent, uint offset, uint len);
 #define buf_ref(buf) kmem_ref(buf);
 void *buf_concatenate(struct buf *b1, struct buf *b2);
 char *buf_to_str(struct buf *buf);
@@ -38,7 +72,13 @@ void buf_dump(struct buf *buf, const char *name);
 void buf_list_dump(struct list *list);
 void buf_put(struct buf *buf, uint payload_len);
 struct list *buf_split(struct buf *buf, char sep);
+struct list *buf_split_view(struct buf *buf, char sep);
+struct list *buf_split_any(struct buf *buf, const char *seps);
+struct list *buf_split_any_view(struct buf *buf, const char *seps);
+struct list *buf_split_str(struct buf *buf, const char *sep);
+struct list *buf_split_str_view(struct buf *buf, const char *sep);
 struct buf *buf_trim(struct buf *buf);
+struct buf *buf_trim_view(struct buf *buf);
 
 #ifdef __cplusplus
 }
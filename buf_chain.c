@@ -0,0 +1,189 @@
+#include "buf_chain.h"
+#include <sys/socket.h>
+#include <unistd.h>
+#include <errno.h>
+
+static void buf_chain_destructor(void *mem)
+{
+    struct buf_chain *chain = (struct buf_chain *)mem;
+    struct le *le, *safe_le;
+    struct buf *buf;
+
+    LIST_FOREACH_SAFE(&chain->bufs, le, safe_le) {
+        buf = (struct buf *)list_ledata(le);
+        list_unlink(le);
+        buf_deref(&buf);
+    }
+}
+
+struct buf_chain *buf_chain_create(void)
+{
+    struct buf_chain *chain;
+    return (struct buf_chain *)kzref_alloc(sizeof *chain, buf_chain_destructor);
+}
+
+/**
+ * Append buffer to the end of chain. Chain takes own reference,
+ * a buffer already linked to another list is appended as a view.
+ * Chain length is counted on append, so payload length of the
+ * buffer must not change while it is in the chain.
+ * @return 0 if ok
+ */
+int buf_chain_append(struct buf_chain *chain, struct buf *buf)
+{
+    uint len = buf_data_len(buf);
+
+    if (!len)
+        return 0;
+
+    if (buf->le.list)
+        buf = buf_view(buf, 0, len);
+    else
+        buf = (struct buf *)buf_ref(buf);
+    if (!buf)
+        return -1;
+
+    buf_list_append(&chain->bufs, buf);
+    chain->len += len;
+    return 0;
+}
+
+/**
+ * Fill iovec array by unconsumed chain data
+ * @return number of iovec entries filled
+ */
+int buf_chain_iov(struct buf_chain *chain, struct iovec *iov, int max_iov)
+{
+    struct le *le;
+    struct buf *buf;
+    uint offset = chain->offset;
+    int cnt = 0;
+
+    LIST_FOREACH(&chain->bufs, le) {
+        if (cnt == max_iov)
+            break;
+        buf = (struct buf *)list_ledata(le);
+        iov[cnt].iov_base = buf->data + offset;
+        iov[cnt].iov_len = buf_data_len(buf) - offset;
+        offset = 0;
+        cnt++;
+    }
+    return cnt;
+}
+
+/**
+ * Drop 'len' bytes from chain head, release fully consumed buffers
+ */
+void buf_chain_consume(struct buf_chain *chain, size_t len)
+{
+    struct le *le;
+    struct buf *buf;
+    uint left;
+
+    len = MIN(len, chain->len);
+    chain->len -= len;
+
+    while (len && (le = list_head(&chain->bufs))) {
+        buf = (struct buf *)list_ledata(le);
+        left = buf_data_len(buf) - chain->offset;
+        if (len < left) {
+            chain->offset += len;
+            return;
+        }
+
+        len -= left;
+        chain->offset = 0;
+        list_unlink(le);
+        buf_deref(&buf);
+    }
+}
+
+/**
+ * Write chain to file descriptor and consume written bytes
+ * @return bytes written or -1 with errno set
+ */
+ssize_t buf_chain_writev(struct buf_chain *chain, int fd)
+{
+    struct iovec iov[BUF_CHAIN_MAX_IOV];
+    ssize_t rc;
+    int cnt;
+
+    cnt = buf_chain_iov(chain, iov, BUF_CHAIN_MAX_IOV);
+    if (!cnt)
+        return 0;
+
+    rc = writev(fd, iov, cnt);
+    if (rc > 0)
+        buf_chain_consume(chain, rc);
+    return rc;
+}
+
+/**
+ * Send chain to socket and consume sent bytes
+ * @param flags: sendmsg() flags, e.g. MSG_NOSIGNAL
+ * @return bytes sent or -1 with errno set
+ */
+ssize_t buf_chain_sendmsg(struct buf_chain *chain, int fd, int flags)
+{
+    struct iovec iov[BUF_CHAIN_MAX_IOV];
+    struct msghdr msg;
+    ssize_t rc;
+    int cnt;
+
+    cnt = buf_chain_iov(chain, iov, BUF_CHAIN_MAX_IOV);
+    if (!cnt)
+        return 0;
+
+    memset(&msg, 0, sizeof msg);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = cnt;
+    rc = sendmsg(fd, &msg, flags);
+    if (rc > 0)
+        buf_chain_consume(chain, rc);
+    return rc;
+}
+
+/**
+ * Read from file descriptor into new buffers appended to chain
+ * @param seg_size: size of every new buffer
+ * @param nr_segs: number of buffers to read into at once
+ * @return bytes read, 0 on end of file or -1 with errno set
+ */
+ssize_t buf_chain_readv(struct buf_chain *chain, int fd,
+                        uint seg_size, int nr_segs)
+{
+    struct iovec iov[BUF_CHAIN_MAX_IOV];
+    struct buf *segs[BUF_CHAIN_MAX_IOV];
+    size_t left;
+    ssize_t rc;
+    int i;
+
+    nr_segs = MIN(nr_segs, BUF_CHAIN_MAX_IOV);
+    for (i = 0; i < nr_segs; i++) {
+        segs[i] = buf_alloc(seg_size);
+        if (!segs[i])
+            break;
+        iov[i].iov_base = segs[i]->data;
+        iov[i].iov_len = seg_size;
+    }
+    nr_segs = i;
+    if (!nr_segs) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    rc = readv(fd, iov, nr_segs);
+
+    left = rc > 0 ? (size_t)rc : 0;
+    for (i = 0; i < nr_segs; i++) {
+        if (left) {
+            buf_put(segs[i], MIN(left, seg_size));
+            left -= segs[i]->payload_len;
+            buf_list_append(&chain->bufs, segs[i]);
+            chain->len += segs[i]->payload_len;
+            continue;
+        }
+        buf_deref(segs + i);
+    }
+    return rc;
+}
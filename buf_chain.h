@@ -0,0 +1,43 @@
+#ifndef BUF_CHAIN_H_
+#define BUF_CHAIN_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#include "buf.h"
+
+/** Maximum number of segments passed to one readv()/writev() call */
+#define BUF_CHAIN_MAX_IOV 64
+
+/**
+ * Sequence of buffers transferred by scatter/gather I/O.
+ * Buffers must keep their payload length while they are chained.
+ */
+struct buf_chain {
+    struct list bufs;  /**< Buffers linked through their struct le */
+    uint offset;       /**< Consumed bytes of head buffer          */
+    size_t len;        /**< Unconsumed bytes in chain              */
+};
+
+struct buf_chain *buf_chain_create(void);
+int buf_chain_append(struct buf_chain *chain, struct buf *buf);
+int buf_chain_iov(struct buf_chain *chain, struct iovec *iov, int max_iov);
+void buf_chain_consume(struct buf_chain *chain, size_t len);
+ssize_t buf_chain_writev(struct buf_chain *chain, int fd);
+ssize_t buf_chain_sendmsg(struct buf_chain *chain, int fd, int flags);
+ssize_t buf_chain_readv(struct buf_chain *chain, int fd,
+                        uint seg_size, int nr_segs);
+
+static inline size_t buf_chain_len(const struct buf_chain *chain)
+{
+    return chain->len;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BUF_CHAIN_H_ */
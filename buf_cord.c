@@ -0,0 +1,164 @@
+#include "buf_cord.h"
+#include <stdlib.h>
+#include <limits.h>
+
+/** Initial size of fragments array */
+#define BUF_CORD_MIN_FRAGS 8
+
+static void buf_cord_release(struct buf_cord *cord)
+{
+    uint i;
+
+    for (i = 0; i < cord->nr_frags; i++)
+        buf_deref(&cord->frags[i].buf);
+    cord->nr_frags = 0;
+}
+
+static void buf_cord_destructor(void *mem)
+{
+    struct buf_cord *cord = (struct buf_cord *)mem;
+
+    buf_cord_release(cord);
+    free(cord->frags);
+}
+
+struct buf_cord *buf_cord_create(void)
+{
+    struct buf_cord *cord;
+    return (struct buf_cord *)kzref_alloc(sizeof *cord, buf_cord_destructor);
+}
+
+/**
+ * Make room for one more fragment, array grows twice
+ */
+static int buf_cord_reserve(struct buf_cord *cord, uint nr)
+{
+    struct buf_cord_frag *frags;
+    uint max = cord->max_frags ? cord->max_frags : BUF_CORD_MIN_FRAGS;
+
+    if (cord->nr_frags + nr <= cord->max_frags)
+        return 0;
+
+    while (max < cord->nr_frags + nr)
+        max *= 2;
+
+    frags = (struct buf_cord_frag *)realloc(cord->frags, max * sizeof *frags);
+    if (!frags) {
+        print_e("can't grow cord to %u fragments\n", max);
+        return -1;
+    }
+    cord->frags = frags;
+    cord->max_frags = max;
+    return 0;
+}
+
+/**
+ * Append buffer to the end of cord. Cord takes own reference,
+ * data is not copied. Cord keeps the current data length of buffer,
+ * later payload changes are not seen by the cord.
+ * @return 0 if ok
+ */
+int buf_cord_append(struct buf_cord *cord, struct buf *buf)
+{
+    uint len = buf_data_len(buf);
+
+    if (!len)
+        return 0;
+
+    if (buf_cord_reserve(cord, 1))
+        return -1;
+
+    cord->frags[cord->nr_frags].buf = (struct buf *)kmem_ref(buf);
+    cord->frags[cord->nr_frags++].len = len;
+    cord->len += len;
+    return 0;
+}
+
+/**
+ * Append all fragments of another cord
+ * @return 0 if ok
+ */
+int buf_cord_append_cord(struct buf_cord *cord, struct buf_cord *src)
+{
+    uint i, nr = src->nr_frags;
+
+    if (buf_cord_reserve(cord, nr))
+        return -1;
+
+    for (i = 0; i < nr; i++) {
+        cord->frags[cord->nr_frags].buf = (struct buf *)kmem_ref(src->frags[i].buf);
+        cord->frags[cord->nr_frags++].len = src->frags[i].len;
+        cord->len += src->frags[i].len;
+    }
+    return 0;
+}
+
+/**
+ * Zero-copy counterpart of buf_concatenate()
+ * @return new cord referencing both buffers
+ */
+struct buf_cord *buf_cord_concatenate(struct buf *b1, struct buf *b2)
+{
+    struct buf_cord *cord = buf_cord_create();
+
+    if (!cord)
+        return NULL;
+
+    if (buf_cord_append(cord, b1) || buf_cord_append(cord, b2)) {
+        kmem_deref(&cord);
+        return NULL;
+    }
+    return cord;
+}
+
+/**
+ * Get cord data as one contiguous buffer. Fragments are copied
+ * once and replaced by the result, so repeated calls are cheap.
+ * @return buffer owned by cord or NULL if cord is empty
+ */
+struct buf *buf_cord_flatten(struct buf_cord *cord)
+{
+    struct buf *flat;
+    uint i, pos = 0;
+
+    if (!cord->nr_frags)
+        return NULL;
+
+    if (cord->nr_frags == 1 && cord->frags[0].len == buf_data_len(cord->frags[0].buf))
+        return cord->frags[0].buf;
+
+    if (cord->len > UINT_MAX) {
+        print_e("cord is too long to flatten: %zu\n", cord->len);
+        return NULL;
+    }
+
+    flat = buf_alloc(cord->len);
+    if (!flat)
+        return NULL;
+
+    for (i = 0; i < cord->nr_frags; i++) {
+        memcpy(flat->data + pos, cord->frags[i].buf->data, cord->frags[i].len);
+        pos += cord->frags[i].len;
+    }
+
+    buf_cord_release(cord);
+    cord->frags[0].buf = flat;
+    cord->frags[0].len = cord->len;
+    cord->nr_frags = 1;
+    return flat;
+}
+
+/**
+ * Fill iovec array by cord fragments
+ * @return number of iovec entries filled
+ */
+int buf_cord_iov(struct buf_cord *cord, struct iovec *iov, int max_iov)
+{
+    uint i;
+
+    for (i = 0; i < cord->nr_frags && (int)i < max_iov; i++) {
+        iov[i].iov_base = cord->frags[i].buf->data;
+        iov[i].iov_len = cord->frags[i].len;
+    }
+    return i;
+}
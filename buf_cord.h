@@ -0,0 +1,48 @@
+#ifndef BUF_CORD_H_
+#define BUF_CORD_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sys/uio.h>
+#include "buf.h"
+
+/** Cord fragment, data length is taken when buffer is appended */
+struct buf_cord_frag {
+    struct buf *buf;
+    uint len;
+};
+
+/**
+ * Rope of referenced buffers, concatenation does not copy data.
+ * Contiguous copy is made only when requested by buf_cord_flatten().
+ */
+struct buf_cord {
+    struct buf_cord_frag *frags; /**< Referenced fragments           */
+    uint nr_frags;
+    uint max_frags;
+    size_t len;          /**< Total data length                       */
+};
+
+struct buf_cord *buf_cord_create(void);
+int buf_cord_append(struct buf_cord *cord, struct buf *buf);
+int buf_cord_append_cord(struct buf_cord *cord, struct buf_cord *src);
+struct buf_cord *buf_cord_concatenate(struct buf *b1, struct buf *b2);
+struct buf *buf_cord_flatten(struct buf_cord *cord);
+int buf_cord_iov(struct buf_cord *cord, struct iovec *iov, int max_iov);
+
+static inline size_t buf_cord_len(const struct buf_cord *cord)
+{
+    return cord->len;
+}
+
+/** Iterate over cord fragments */
+#define BUF_CORD_FOREACH(cord, i, buf) \
+    for ((i) = 0; (i) < (cord)->nr_frags && ((buf) = (cord)->frags[i].buf); (i)++)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BUF_CORD_H_ */
@@ -0,0 +1,228 @@
+#define _GNU_SOURCE
+#include "buf_ring.h"
+#include "buf_scan.h"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <errno.h>
+
+static void buf_ring_destructor(void *mem)
+{
+    struct buf_ring *ring = (struct buf_ring *)mem;
+
+    if (ring->buf.data)
+        munmap(ring->buf.data, (size_t)ring->size * 2);
+}
+
+#ifdef __linux__
+/**
+ * Map memfd of 'size' bytes twice into one reserved area
+ * @return mapping start or NULL
+ */
+static u8 *buf_ring_map(uint size)
+{
+    u8 *base, *p;
+    int fd;
+
+    fd = memfd_create("buf_ring", MFD_CLOEXEC);
+    if (fd < 0) {
+        print_e("memfd_create() failed: %d\n", errno);
+        return NULL;
+    }
+
+    if (ftruncate(fd, size)) {
+        print_e("ftruncate() failed: %d\n", errno);
+        close(fd);
+        return NULL;
+    }
+
+    base = mmap(NULL, (size_t)size * 2, PROT_NONE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+
+    p = mmap(base, size, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_FIXED, fd, 0);
+    if (p != MAP_FAILED)
+        p = mmap(base + size, size, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_FIXED, fd, 0);
+    close(fd);
+
+    if (p == MAP_FAILED) {
+        print_e("can't mirror ring mapping: %d\n", errno);
+        munmap(base, (size_t)size * 2);
+        return NULL;
+    }
+    return base;
+}
+#else
+static u8 *buf_ring_map(uint size)
+{
+    UNUSED(size);
+    print_e("mirrored rings are supported on Linux only\n");
+    return NULL;
+}
+#endif
+
+/**
+ * Create byte ring
+ * @param size: capacity, rounded up to page size
+ */
+struct buf_ring *buf_ring_create(uint size)
+{
+    struct buf_ring *ring;
+    uint page_size = (uint)sysconf(_SC_PAGESIZE);
+
+    if (!size || size > (1U << 30))
+        return NULL;
+    size = (size + page_size - 1) & ~(page_size - 1);
+
+    ring = (struct buf_ring *)kzref_alloc(sizeof *ring, buf_ring_destructor);
+    if (!ring)
+        return NULL;
+
+    ring->buf.data = buf_ring_map(size);
+    if (!ring->buf.data) {
+        kmem_deref(&ring);
+        return NULL;
+    }
+    ring->buf.len = size * 2;
+    ring->size = size;
+    return ring;
+}
+
+/**
+ * Get contiguous free space
+ * @param avail: returns free space length
+ */
+u8 *buf_ring_write_ptr(struct buf_ring *ring, uint *avail)
+{
+    *avail = ring->size - ring->used;
+    return ring->buf.data + ring->head + ring->used;
+}
+
+/**
+ * Make 'len' bytes written to buf_ring_write_ptr() readable
+ */
+void buf_ring_produce(struct buf_ring *ring, uint len)
+{
+    ring->used += MIN(len, ring->size - ring->used);
+}
+
+/**
+ * Get contiguous readable data
+ * @param len: returns data length
+ */
+u8 *buf_ring_read_ptr(struct buf_ring *ring, uint *len)
+{
+    *len = ring->used;
+    return ring->buf.data + ring->head;
+}
+
+/**
+ * Release 'len' bytes from ring head
+ */
+void buf_ring_consume(struct buf_ring *ring, uint len)
+{
+    len = MIN(len, ring->used);
+    ring->used -= len;
+    ring->head += len;
+    if (ring->head >= ring->size)
+        ring->head -= ring->size;
+}
+
+/**
+ * Copy data to ring
+ * @return 0 if ok, -1 if there is not enough free space
+ */
+int buf_ring_write(struct buf_ring *ring, const void *data, uint len)
+{
+    uint avail;
+    u8 *p = buf_ring_write_ptr(ring, &avail);
+
+    if (len > avail)
+        return -1;
+
+    memcpy(p, data, len);
+    buf_ring_produce(ring, len);
+    return 0;
+}
+
+/**
+ * Fill free space by one read() call
+ * @return bytes read, 0 on end of file or -1 with errno set
+ */
+ssize_t buf_ring_read_fd(struct buf_ring *ring, int fd)
+{
+    uint avail;
+    u8 *p = buf_ring_write_ptr(ring, &avail);
+    ssize_t rc;
+
+    if (!avail) {
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    rc = read(fd, p, avail);
+    if (rc > 0)
+        buf_ring_produce(ring, rc);
+    return rc;
+}
+
+/**
+ * Make view of readable data, the ring is not consumed
+ * @param offset: view start relative to ring head
+ * @param len: view length
+ */
+struct buf *buf_ring_view(struct buf_ring *ring, uint offset, uint len)
+{
+    if (offset > ring->used || len > ring->used - offset)
+        return NULL;
+    return buf_view(&ring->buf, ring->head + offset, len);
+}
+
+/**
+ * Take record ending at 'sep_pos' and consume it with separator
+ */
+static struct buf *buf_ring_take(struct buf_ring *ring, const u8 *sep_pos,
+                                 uint sep_len)
+{
+    uint len = sep_pos - (ring->buf.data + ring->head);
+    struct buf *record;
+
+    record = buf_ring_view(ring, 0, len);
+    if (record)
+        buf_ring_consume(ring, len + sep_len);
+    return record;
+}
+
+/**
+ * Take next complete record terminated by multi-byte separator.
+ * Record may span the wrap point and is never copied.
+ * @return view of record without separator or NULL if
+ *         there is no complete record yet
+ */
+struct buf *buf_ring_next(struct buf_ring *ring, const char *sep)
+{
+    uint sep_len = (uint)strlen(sep);
+    const u8 *p;
+
+    p = buf_scan_str(ring->buf.data + ring->head, ring->used,
+                     (const u8 *)sep, sep_len);
+    return p ? buf_ring_take(ring, p, sep_len) : NULL;
+}
+
+/**
+ * Take next complete record terminated by any of separators
+ * @return view of record without separator or NULL if
+ *         there is no complete record yet
+ */
+struct buf *buf_ring_next_any(struct buf_ring *ring, const char *seps)
+{
+    const u8 *p;
+
+    p = buf_scan_any(ring->buf.data + ring->head, ring->used,
+                     (const u8 *)seps, (uint)strlen(seps));
+    return p ? buf_ring_take(ring, p, 1) : NULL;
+}
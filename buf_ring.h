@@ -0,0 +1,49 @@
+#ifndef BUF_RING_H_
+#define BUF_RING_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sys/types.h>
+#include "buf.h"
+
+/**
+ * Byte ring mapped twice back-to-back, so readable and writable
+ * areas are always contiguous even across the wrap point.
+ * Views returned by buf_ring functions point into ring memory:
+ * their data is valid until the space is consumed and written again.
+ */
+struct buf_ring {
+    struct buf buf;  /**< Both mappings, parent of views        */
+    uint size;       /**< Capacity, multiple of page size       */
+    uint head;       /**< Read offset in first mapping          */
+    uint used;       /**< Readable bytes                        */
+};
+
+struct buf_ring *buf_ring_create(uint size);
+u8 *buf_ring_write_ptr(struct buf_ring *ring, uint *avail);
+void buf_ring_produce(struct buf_ring *ring, uint len);
+u8 *buf_ring_read_ptr(struct buf_ring *ring, uint *len);
+void buf_ring_consume(struct buf_ring *ring, uint len);
+int buf_ring_write(struct buf_ring *ring, const void *data, uint len);
+ssize_t buf_ring_read_fd(struct buf_ring *ring, int fd);
+struct buf *buf_ring_view(struct buf_ring *ring, uint offset, uint len);
+struct buf *buf_ring_next(struct buf_ring *ring, const char *sep);
+struct buf *buf_ring_next_any(struct buf_ring *ring, const char *seps);
+
+static inline uint buf_ring_used(const struct buf_ring *ring)
+{
+    return ring->used;
+}
+
+static inline uint buf_ring_avail(const struct buf_ring *ring)
+{
+    return ring->size - ring->used;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BUF_RING_H_ */
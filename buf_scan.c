@@ -0,0 +1,217 @@
+#include "buf_scan.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #define BUF_SCAN_X86
+    #include <immintrin.h>
+#endif
+
+typedef const u8 *(*buf_scan_fn)(const u8 *data, uint len,
+                                 const u8 *seps, uint nr_seps);
+
+static buf_scan_fn buf_scan_impl;
+static const char *buf_scan_impl_name;
+
+
+/**
+ * Portable kernel, also handles tails of vector kernels
+ */
+static const u8 *scan_any_generic(const u8 *data, uint len,
+                                  const u8 *seps, uint nr_seps)
+{
+    u8 table[256];
+    const u8 *end = data + len;
+    uint i;
+
+    if (nr_seps == 1)
+        return (const u8 *)memchr(data, seps[0], len);
+
+    if (len < 64 && nr_seps <= 4) {
+        for (; data < end; data++)
+            for (i = 0; i < nr_seps; i++)
+                if (*data == seps[i])
+                    return data;
+        return NULL;
+    }
+
+    memset(table, 0, sizeof table);
+    for (i = 0; i < nr_seps; i++)
+        table[seps[i]] = 1;
+
+    for (; data < end; data++)
+        if (table[*data])
+            return data;
+    return NULL;
+}
+
+
+#ifdef BUF_SCAN_X86
+__attribute__((target("sse2")))
+static const u8 *scan_any_sse2(const u8 *data, uint len,
+                               const u8 *seps, uint nr_seps)
+{
+    __m128i sep[BUF_SCAN_MAX_SEPS];
+    __m128i block, match;
+    uint i, mask;
+
+    if (nr_seps > BUF_SCAN_MAX_SEPS)
+        return scan_any_generic(data, len, seps, nr_seps);
+
+    for (i = 0; i < nr_seps; i++)
+        sep[i] = _mm_set1_epi8((char)seps[i]);
+
+    for (; len >= 16; data += 16, len -= 16) {
+        block = _mm_loadu_si128((const __m128i *)data);
+        match = _mm_cmpeq_epi8(block, sep[0]);
+        for (i = 1; i < nr_seps; i++)
+            match = _mm_or_si128(match, _mm_cmpeq_epi8(block, sep[i]));
+
+        mask = (uint)_mm_movemask_epi8(match);
+        if (mask)
+            return data + __builtin_ctz(mask);
+    }
+    return scan_any_generic(data, len, seps, nr_seps);
+}
+
+
+__attribute__((target("avx2")))
+static const u8 *scan_any_avx2(const u8 *data, uint len,
+                               const u8 *seps, uint nr_seps)
+{
+    __m256i sep[BUF_SCAN_MAX_SEPS];
+    __m256i lo, hi, match_lo, match_hi;
+    uint i, mask;
+    unsigned long long mask2;
+
+    if (nr_seps > BUF_SCAN_MAX_SEPS)
+        return scan_any_generic(data, len, seps, nr_seps);
+
+    for (i = 0; i < nr_seps; i++)
+        sep[i] = _mm256_set1_epi8((char)seps[i]);
+
+    /* two vectors per iteration to hide compare latency */
+    for (; len >= 64; data += 64, len -= 64) {
+        lo = _mm256_loadu_si256((const __m256i *)data);
+        hi = _mm256_loadu_si256((const __m256i *)(data + 32));
+        match_lo = _mm256_cmpeq_epi8(lo, sep[0]);
+        match_hi = _mm256_cmpeq_epi8(hi, sep[0]);
+        for (i = 1; i < nr_seps; i++) {
+            match_lo = _mm256_or_si256(match_lo, _mm256_cmpeq_epi8(lo, sep[i]));
+            match_hi = _mm256_or_si256(match_hi, _mm256_cmpeq_epi8(hi, sep[i]));
+        }
+
+        if (_mm256_testz_si256(_mm256_or_si256(match_lo, match_hi),
+                               _mm256_set1_epi8(-1)))
+            continue;
+
+        mask2 = (uint)_mm256_movemask_epi8(match_lo) |
+                ((unsigned long long)(uint)_mm256_movemask_epi8(match_hi) << 32);
+        return data + __builtin_ctzll(mask2);
+    }
+
+    for (; len >= 32; data += 32, len -= 32) {
+        lo = _mm256_loadu_si256((const __m256i *)data);
+        match_lo = _mm256_cmpeq_epi8(lo, sep[0]);
+        for (i = 1; i < nr_seps; i++)
+            match_lo = _mm256_or_si256(match_lo, _mm256_cmpeq_epi8(lo, sep[i]));
+
+        mask = (uint)_mm256_movemask_epi8(match_lo);
+        if (mask)
+            return data + __builtin_ctz(mask);
+    }
+    return scan_any_generic(data, len, seps, nr_seps);
+}
+#endif
+
+
+/**
+ * Select the best kernel supported by CPU
+ */
+static buf_scan_fn buf_scan_select(void)
+{
+    buf_scan_fn impl = scan_any_generic;
+    const char *name = "generic";
+
+#ifdef BUF_SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        impl = scan_any_avx2;
+        name = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        impl = scan_any_sse2;
+        name = "sse2";
+    }
+#endif
+
+    __atomic_store_n(&buf_scan_impl_name, name, __ATOMIC_RELAXED);
+    __atomic_store_n(&buf_scan_impl, impl, __ATOMIC_RELAXED);
+    return impl;
+}
+
+
+/**
+ * Find first byte which is one of separators
+ * @param data: data to search in
+ * @param len: data length
+ * @param seps: separators set
+ * @param nr_seps: number of separators
+ * @return pointer to separator or NULL if not found
+ */
+const u8 *buf_scan_any(const u8 *data, uint len, const u8 *seps, uint nr_seps)
+{
+    buf_scan_fn impl;
+
+    if (!nr_seps || !len)
+        return NULL;
+
+    /* libc memchr() is already vectorized */
+    if (nr_seps == 1)
+        return (const u8 *)memchr(data, seps[0], len);
+
+    impl = __atomic_load_n(&buf_scan_impl, __ATOMIC_RELAXED);
+    if (!impl)
+        impl = buf_scan_select();
+    return impl(data, len, seps, nr_seps);
+}
+
+
+/**
+ * Find first occurrence of multi-byte separator
+ * @param data: data to search in
+ * @param len: data length
+ * @param sep: separator
+ * @param sep_len: separator length
+ * @return pointer to separator or NULL if not found
+ */
+const u8 *buf_scan_str(const u8 *data, uint len, const u8 *sep, uint sep_len)
+{
+    const u8 *end = data + len;
+    const u8 *p;
+
+    if (!sep_len)
+        return NULL;
+
+    while ((uint)(end - data) >= sep_len) {
+        p = (const u8 *)memchr(data, sep[0], end - data - sep_len + 1);
+        if (!p)
+            return NULL;
+        if (!memcmp(p + 1, sep + 1, sep_len - 1))
+            return p;
+        data = p + 1;
+    }
+    return NULL;
+}
+
+
+/**
+ * Get name of kernel used by buf_scan_any()
+ */
+const char *buf_scan_kernel(void)
+{
+    const char *name = __atomic_load_n(&buf_scan_impl_name, __ATOMIC_RELAXED);
+    if (!name) {
+        buf_scan_select();
+        name = __atomic_load_n(&buf_scan_impl_name, __ATOMIC_RELAXED);
+    }
+    return name;
+}
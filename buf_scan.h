@@ -0,0 +1,21 @@
+#ifndef BUF_SCAN_H_
+#define BUF_SCAN_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "types.h"
+
+/** Longest separator set handled by vector kernels */
+#define BUF_SCAN_MAX_SEPS 16
+
+const u8 *buf_scan_any(const u8 *data, uint len, const u8 *seps, uint nr_seps);
+const u8 *buf_scan_str(const u8 *data, uint len, const u8 *sep, uint sep_len);
+const char *buf_scan_kernel(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BUF_SCAN_H_ */
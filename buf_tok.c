@@ -0,0 +1,203 @@
+#include "buf_tok.h"
+
+static void buf_tok_destructor(void *mem)
+{
+    struct buf_tok *tok = (struct buf_tok *)mem;
+    buf_deref(&tok->carry);
+}
+
+static struct buf_tok *buf_tok_alloc(const char *sep, bool is_set)
+{
+    struct buf_tok *tok;
+    uint len = (uint)strlen(sep);
+
+    if (!len || len > BUF_SCAN_MAX_SEPS)
+        return NULL;
+
+    tok = (struct buf_tok *)kzref_alloc(sizeof *tok, buf_tok_destructor);
+    if (!tok)
+        return NULL;
+
+    memcpy(tok->sep, sep, len);
+    tok->sep_len = len;
+    tok->is_set = is_set;
+    return tok;
+}
+
+/**
+ * Create tokenizer splitting by any byte of separators set
+ * @param seps: separators, e.g. ",;"
+ */
+struct buf_tok *buf_tok_create(const char *seps)
+{
+    return buf_tok_alloc(seps, TRUE);
+}
+
+/**
+ * Create tokenizer splitting by multi-byte separator
+ * @param sep: separator, e.g. "\r\n"
+ */
+struct buf_tok *buf_tok_create_str(const char *sep)
+{
+    return buf_tok_alloc(sep, FALSE);
+}
+
+static const u8 *buf_tok_find(struct buf_tok *tok, const u8 *p, uint len)
+{
+    if (tok->is_set)
+        return buf_scan_any(p, len, tok->sep, tok->sep_len);
+    return buf_scan_str(p, len, tok->sep, tok->sep_len);
+}
+
+static uint buf_tok_sep_step(struct buf_tok *tok)
+{
+    return tok->is_set ? 1 : tok->sep_len;
+}
+
+/**
+ * Find multi-byte separator started in carried data
+ * and finished in the new chunk
+ * @return number of separator bytes in carry or 0
+ */
+static uint buf_tok_boundary(struct buf_tok *tok, const u8 *p, uint len)
+{
+    const u8 *tail;
+    uint k;
+
+    if (tok->is_set)
+        return 0;
+
+    for (k = MIN(tok->sep_len - 1, tok->carry_len); k; k--) {
+        tail = tok->carry->data + tok->carry_len - k;
+        if (len >= tok->sep_len - k &&
+            !memcmp(tail, tok->sep, k) &&
+            !memcmp(p, tok->sep + k, tok->sep_len - k))
+            return k;
+    }
+    return 0;
+}
+
+/**
+ * Keep partial token till next chunk
+ */
+static int buf_tok_carry(struct buf_tok *tok, const u8 *p, uint len)
+{
+    struct buf *carry;
+    uint size;
+
+    if (!tok->carry || tok->carry_len + len > tok->carry->len) {
+        size = tok->carry ? tok->carry->len * 2 : 64;
+        size = MAX(size, tok->carry_len + len);
+        carry = buf_alloc(size);
+        if (!carry)
+            return -1;
+        if (tok->carry_len)
+            memcpy(carry->data, tok->carry->data, tok->carry_len);
+        buf_deref(&tok->carry);
+        tok->carry = carry;
+    }
+
+    memcpy(tok->carry->data + tok->carry_len, p, len);
+    tok->carry_len += len;
+    return 0;
+}
+
+static int buf_tok_emit(struct buf *token, buf_tok_cb cb, void *arg)
+{
+    int rc;
+
+    if (!token)
+        return -1;
+    rc = cb(token, arg);
+    buf_deref(&token);
+    return rc;
+}
+
+/**
+ * Emit carried data followed by 'len' bytes of new chunk
+ */
+static int buf_tok_flush(struct buf_tok *tok, const u8 *p, uint len,
+                         buf_tok_cb cb, void *arg)
+{
+    struct buf *token;
+    uint total = tok->carry_len + len;
+
+    tok->carry_len = 0;
+    if (!total)
+        return 0;
+
+    token = buf_alloc(total);
+    if (!token)
+        return -1;
+    if (total > len)
+        memcpy(token->data, tok->carry->data, total - len);
+    if (len)
+        memcpy(token->data + total - len, p, len);
+    buf_put(token, total);
+    return buf_tok_emit(token, cb, arg);
+}
+
+/**
+ * Feed next chunk of stream. Complete tokens are passed to callback,
+ * tokens inside the chunk as views of it, tokens crossing chunk
+ * boundary as new buffers. Empty tokens are skipped.
+ * If callback stops tokenizing the rest of chunk is dropped.
+ * @param tok: tokenizer
+ * @param chunk: next data chunk
+ * @param cb: token callback
+ * @param arg: callback argument
+ * @return 0 if ok, -1 if no memory or callback error code
+ */
+int buf_tok_feed(struct buf_tok *tok, struct buf *chunk,
+                 buf_tok_cb cb, void *arg)
+{
+    const u8 *p = chunk->data;
+    const u8 *end = chunk->data + buf_data_len(chunk);
+    const u8 *found;
+    uint k;
+    int rc;
+
+    if (tok->carry_len) {
+        k = buf_tok_boundary(tok, p, end - p);
+        if (k) {
+            tok->carry_len -= k;
+            rc = buf_tok_flush(tok, NULL, 0, cb, arg);
+            if (rc)
+                return rc;
+            p += tok->sep_len - k;
+        } else {
+            found = buf_tok_find(tok, p, end - p);
+            if (!found)
+                return buf_tok_carry(tok, p, end - p);
+
+            rc = buf_tok_flush(tok, p, found - p, cb, arg);
+            if (rc)
+                return rc;
+            p = found + buf_tok_sep_step(tok);
+        }
+    }
+
+    while (p < end) {
+        found = buf_tok_find(tok, p, end - p);
+        if (!found)
+            return buf_tok_carry(tok, p, end - p);
+
+        if (found > p) {
+            rc = buf_tok_emit(buf_view(chunk, p - chunk->data, found - p),
+                              cb, arg);
+            if (rc)
+                return rc;
+        }
+        p = found + buf_tok_sep_step(tok);
+    }
+    return 0;
+}
+
+/**
+ * Finish stream, emit last token if it was not terminated by separator
+ * @return 0 if ok, -1 if no memory or callback error code
+ */
+int buf_tok_finish(struct buf_tok *tok, buf_tok_cb cb, void *arg)
+{
+    return buf_tok_flush(tok, NULL, 0, cb, arg);
+}
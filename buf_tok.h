@@ -0,0 +1,37 @@
+#ifndef BUF_TOK_H_
+#define BUF_TOK_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "buf.h"
+#include "buf_scan.h"
+
+/**
+ * Token callback. The token is released after return,
+ * take buf_ref() to keep it.
+ * @return 0 to continue or error code to stop tokenizing
+ */
+typedef int (*buf_tok_cb)(struct buf *token, void *arg);
+
+/** Incremental tokenizer state */
+struct buf_tok {
+    u8 sep[BUF_SCAN_MAX_SEPS]; /**< Separator bytes                      */
+    uint sep_len;              /**< Number of separator bytes            */
+    bool is_set;               /**< Any of sep bytes or one multi-byte   */
+    struct buf *carry;         /**< Partial token from previous chunks   */
+    uint carry_len;            /**< Bytes used in carry                  */
+};
+
+struct buf_tok *buf_tok_create(const char *seps);
+struct buf_tok *buf_tok_create_str(const char *sep);
+int buf_tok_feed(struct buf_tok *tok, struct buf *chunk,
+                 buf_tok_cb cb, void *arg);
+int buf_tok_finish(struct buf_tok *tok, buf_tok_cb cb, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BUF_TOK_H_ */
@@ -0,0 +1,432 @@
+#include "hash.h"
+#include "kref_alloc.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** Smallest number of buckets */
+#define HASH_MIN_SIZE 16
+
+/** Old buckets moved to the new array by every add */
+#define HASH_REHASH_STEP 4
+
+static const unsigned long long wy_secret[4] = {
+    0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL,
+    0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL,
+};
+
+
+/**
+ * 64x64 -> 128 bit multiplication, low half to A, high half to B
+ */
+static inline void wy_mum(unsigned long long *a, unsigned long long *b)
+{
+#ifdef __SIZEOF_INT128__
+    __uint128_t r = (__uint128_t)*a * *b;
+    *a = (unsigned long long)r;
+    *b = (unsigned long long)(r >> 64);
+#else
+    unsigned long long ha = *a >> 32, hb = *b >> 32;
+    unsigned long long la = (u32)*a, lb = (u32)*b;
+    unsigned long long rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    unsigned long long t = rl + (rm0 << 32), lo, c = t < rl;
+
+    lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline unsigned long long wy_mix(unsigned long long a,
+                                        unsigned long long b)
+{
+    wy_mum(&a, &b);
+    return a ^ b;
+}
+
+static inline unsigned long long wy_r8(const u8 *p)
+{
+    unsigned long long v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static inline unsigned long long wy_r4(const u8 *p)
+{
+    u32 v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static inline unsigned long long wy_r3(const u8 *p, uint k)
+{
+    return ((unsigned long long)p[0] << 16) |
+           ((unsigned long long)p[k >> 1] << 8) | p[k - 1];
+}
+
+
+/**
+ * wyhash (final version 4 by Wang Yi), fast default hash function
+ * @param key: key bytes
+ * @param len: key length
+ * @param seed: hash seed
+ */
+unsigned long long hash_wyhash(const void *key, uint len, unsigned long long seed)
+{
+    const u8 *p = (const u8 *)key;
+    unsigned long long a, b, see1, see2;
+    uint i = len;
+
+    seed ^= wy_mix(seed ^ wy_secret[0], wy_secret[1]);
+
+    if (len <= 16) {
+        if (len >= 4) {
+            a = (wy_r4(p) << 32) | wy_r4(p + ((len >> 3) << 2));
+            b = (wy_r4(p + len - 4) << 32) | wy_r4(p + len - 4 - ((len >> 3) << 2));
+        } else if (len) {
+            a = wy_r3(p, len);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        if (i > 48) {
+            see1 = see2 = seed;
+            do {
+                seed = wy_mix(wy_r8(p) ^ wy_secret[1], wy_r8(p + 8) ^ seed);
+                see1 = wy_mix(wy_r8(p + 16) ^ wy_secret[2], wy_r8(p + 24) ^ see1);
+                see2 = wy_mix(wy_r8(p + 32) ^ wy_secret[3], wy_r8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = wy_mix(wy_r8(p) ^ wy_secret[1], wy_r8(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+        a = wy_r8(p + i - 16);
+        b = wy_r8(p + i - 8);
+    }
+
+    a ^= wy_secret[1];
+    b ^= seed;
+    wy_mum(&a, &b);
+    return wy_mix(a ^ wy_secret[0] ^ len, b ^ wy_secret[1]);
+}
+
+
+/**
+ * FNV-1a, simple byte-wise hash function
+ */
+unsigned long long hash_fnv1a(const void *key, uint len, unsigned long long seed)
+{
+    const u8 *p = (const u8 *)key;
+    unsigned long long h = 0xcbf29ce484222325ULL ^ seed;
+
+    while (len--) {
+        h ^= *p++;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+
+static void hash_destructor(void *mem)
+{
+    struct hash *h = (struct hash *)mem;
+    struct hnode *hn, *next;
+    void *item;
+    uint i;
+
+    for (i = 0; h->old && i <= h->old_mask; i++)
+        for (hn = h->old[i]; hn; hn = next) {
+            next = hn->next;
+            item = hn->data;
+            hn->next = NULL;
+            hn->hash = NULL;
+            hn->data = NULL;
+            kmem_deref(&item);
+        }
+
+    for (i = 0; h->buckets && i <= h->mask; i++)
+        for (hn = h->buckets[i]; hn; hn = next) {
+            next = hn->next;
+            item = hn->data;
+            hn->next = NULL;
+            hn->hash = NULL;
+            hn->data = NULL;
+            kmem_deref(&item);
+        }
+
+    free(h->old);
+    free(h->buckets);
+}
+
+
+/**
+ * Create hash table
+ * @param size: expected number of elements, table grows if needed
+ * @param key: returns key bytes of element user-data
+ * @param fn: hash function, NULL for hash_wyhash()
+ * @return new table or NULL
+ */
+struct hash *hash_create(uint size, hash_key_fn key, hash_fn fn)
+{
+    struct hash *h;
+    uint nr = HASH_MIN_SIZE;
+
+    if (!key)
+        return NULL;
+
+    while (nr < size && nr < (1U << 31))
+        nr <<= 1;
+
+    h = (struct hash *)kzref_alloc(sizeof *h, hash_destructor);
+    if (!h)
+        return NULL;
+
+    h->buckets = (struct hnode **)calloc(nr, sizeof *h->buckets);
+    if (!h->buckets) {
+        print_e("can't allocate %u hash buckets\n", nr);
+        kmem_deref(&h);
+        return NULL;
+    }
+    h->mask = nr - 1;
+    h->key = key;
+    h->fn = fn ? fn : hash_wyhash;
+    h->seed = wy_secret[2];
+    return h;
+}
+
+
+/**
+ * Get bucket holding elements of key hash
+ */
+static struct hnode **hash_bucket(const struct hash *h,
+                                  unsigned long long key_hash)
+{
+    uint i;
+
+    if (h->old) {
+        i = key_hash & h->old_mask;
+        if (i >= h->rehash_pos)
+            return h->old + i;
+    }
+    return h->buckets + (key_hash & h->mask);
+}
+
+
+/**
+ * Move next few old buckets to the new array
+ */
+static void hash_rehash_step(struct hash *h)
+{
+    struct hnode *hn, *next, **bucket;
+    uint n;
+
+    for (n = 0; n < HASH_REHASH_STEP && h->rehash_pos <= h->old_mask; n++) {
+        for (hn = h->old[h->rehash_pos]; hn; hn = next) {
+            next = hn->next;
+            bucket = h->buckets + (hn->key_hash & h->mask);
+            hn->next = *bucket;
+            *bucket = hn;
+        }
+        h->old[h->rehash_pos++] = NULL;
+    }
+
+    if (h->rehash_pos > h->old_mask) {
+        free(h->old);
+        h->old = NULL;
+    }
+}
+
+
+/**
+ * Start moving elements to buckets array twice bigger
+ */
+static void hash_grow(struct hash *h)
+{
+    struct hnode **buckets;
+    uint nr = (h->mask + 1) * 2;
+
+    if (!nr)
+        return;
+
+    buckets = (struct hnode **)calloc(nr, sizeof *buckets);
+    if (!buckets) {
+        print_e("can't grow hash to %u buckets\n", nr);
+        return;
+    }
+
+    h->old = h->buckets;
+    h->old_mask = h->mask;
+    h->rehash_pos = 0;
+    h->buckets = buckets;
+    h->mask = nr - 1;
+}
+
+
+/**
+ * Add element to hash table, table takes caller's reference to data.
+ * Elements with equal keys are allowed, lookup finds any of them.
+ * @param h: hash table
+ * @param hn: element embedded in data
+ * @param data: element user-data, its key is returned by table key function
+ * @return 0 if ok
+ */
+int hash_add(struct hash *h, struct hnode *hn, void *data)
+{
+    struct hnode **bucket;
+    const void *key;
+    uint len = 0;
+
+    if (!h || !hn || hn->hash)
+        return -1;
+
+    key = h->key(data, &len);
+    if (!key && len)
+        return -1;
+
+    if (h->old)
+        hash_rehash_step(h);
+    else if (h->count >= h->mask + 1)
+        hash_grow(h);
+
+    hn->key_hash = h->fn(key, len, h->seed);
+    hn->hash = h;
+    hn->data = data;
+    bucket = hash_bucket(h, hn->key_hash);
+    hn->next = *bucket;
+    *bucket = hn;
+    h->count++;
+    return 0;
+}
+
+
+/**
+ * Find element by key
+ * @param h: hash table
+ * @param key: key bytes
+ * @param len: key length
+ * @return element user-data or NULL if not found
+ */
+void *hash_lookup(const struct hash *h, const void *key, uint len)
+{
+    unsigned long long key_hash;
+    const void *hn_key;
+    struct hnode *hn;
+    uint hn_len;
+
+    if (!h || !h->count)
+        return NULL;
+
+    key_hash = h->fn(key, len, h->seed);
+    for (hn = *hash_bucket(h, key_hash); hn; hn = hn->next) {
+        if (hn->key_hash != key_hash)
+            continue;
+        hn_len = 0;
+        hn_key = h->key(hn->data, &hn_len);
+        if (hn_len == len && (!len || !memcmp(hn_key, key, len)))
+            return hn->data;
+    }
+    return NULL;
+}
+
+
+/**
+ * Remove element from its hash table, data is not dereferenced
+ * @param hn: element to remove
+ */
+void hash_unlink(struct hnode *hn)
+{
+    struct hash *h;
+    struct hnode **pp;
+
+    if (!hn || !hn->hash)
+        return;
+
+    h = hn->hash;
+    for (pp = hash_bucket(h, hn->key_hash); *pp && *pp != hn; pp = &(*pp)->next);
+    if (!*pp) {
+        print_e("hash element %p is not in its table %p\n", (void *)hn, (void *)h);
+        return;
+    }
+
+    *pp = hn->next;
+    hn->next = NULL;
+    hn->hash = NULL;
+    h->count--;
+}
+
+
+/**
+ * Call handler for every element until it returns true.
+ * Handler may unlink element it is called for but must not add.
+ * @return user-data of element handler stopped at or NULL
+ */
+void *hash_apply(const struct hash *h, hash_apply_h fn, void *arg)
+{
+    struct hnode *hn, *next;
+    uint i;
+
+    if (!h || !fn)
+        return NULL;
+
+    for (i = h->rehash_pos; h->old && i <= h->old_mask; i++)
+        for (hn = h->old[i]; hn; hn = next) {
+            next = hn->next;
+            if (fn(hn->data, arg))
+                return hn->data;
+        }
+
+    for (i = 0; i <= h->mask; i++)
+        for (hn = h->buckets[i]; hn; hn = next) {
+            next = hn->next;
+            if (fn(hn->data, arg))
+                return hn->data;
+        }
+    return NULL;
+}
+
+
+/**
+ * Unlink all elements without dereferencing them
+ */
+void hash_clear(struct hash *h)
+{
+    struct hnode *hn, *next;
+    uint i;
+
+    if (!h)
+        return;
+
+    for (i = h->rehash_pos; h->old && i <= h->old_mask; i++)
+        for (hn = h->old[i]; hn; hn = next) {
+            next = hn->next;
+            hn->next = NULL;
+            hn->hash = NULL;
+        }
+    free(h->old);
+    h->old = NULL;
+
+    for (i = 0; i <= h->mask; i++) {
+        for (hn = h->buckets[i]; hn; hn = next) {
+            next = hn->next;
+            hn->next = NULL;
+            hn->hash = NULL;
+        }
+        h->buckets[i] = NULL;
+    }
+    h->count = 0;
+}
+
+
+/**
+ * deref all table elements and self table
+ */
+void hash_destroy(struct hash *h)
+{
+    kmem_deref(&h);
+}
@@ -0,0 +1,72 @@
+#ifndef HASH_H_
+#define HASH_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "types.h"
+
+/** Hash table element, embedded in hashed object like struct le */
+struct hnode {
+    struct hnode *next;            /**< Next element in bucket         */
+    struct hash *hash;             /**< Parent table (NULL if unlinked) */
+    unsigned long long key_hash;   /**< Hash of element key            */
+    void *data;                    /**< User-data                      */
+};
+
+/** Hash Element Initializer */
+#define HNODE_INIT {NULL, NULL, 0, NULL}
+
+/** Hash function of key bytes */
+typedef unsigned long long (*hash_fn)(const void *key, uint len,
+                                      unsigned long long seed);
+
+/** Get key bytes of element user-data */
+typedef const void *(*hash_key_fn)(const void *data, uint *len);
+
+/** Iteration handler, returns true to stop */
+typedef bool (*hash_apply_h)(void *data, void *arg);
+
+/**
+ * Chained hash table of kref_alloc() objects. Grows twice when
+ * number of elements reaches number of buckets, old buckets are
+ * moved to the new array a few at a time by following add calls,
+ * so no single call pays for the whole resize.
+ */
+struct hash {
+    struct hnode **buckets;
+    uint mask;
+    struct hnode **old;      /**< Buckets being moved, NULL if not resizing */
+    uint old_mask;
+    uint rehash_pos;         /**< Old buckets below are moved already */
+    uint count;
+    hash_key_fn key;
+    hash_fn fn;
+    unsigned long long seed;
+};
+
+unsigned long long hash_wyhash(const void *key, uint len, unsigned long long seed);
+unsigned long long hash_fnv1a(const void *key, uint len, unsigned long long seed);
+
+struct hash *hash_create(uint size, hash_key_fn key, hash_fn fn);
+int hash_add(struct hash *h, struct hnode *hn, void *data);
+void *hash_lookup(const struct hash *h, const void *key, uint len);
+void hash_unlink(struct hnode *hn);
+void *hash_apply(const struct hash *h, hash_apply_h fn, void *arg);
+void hash_clear(struct hash *h);
+void hash_destroy(struct hash *h);
+
+static inline uint hash_count(const struct hash *h)
+{
+    return h ? h->count : 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HASH_H_ */
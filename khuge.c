@@ -0,0 +1,247 @@
+#define _GNU_SOURCE
+#include "khuge.h"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+#ifndef MPOL_BIND
+#define MPOL_BIND 2
+#endif
+
+/** Freed mappings kept for reuse */
+#define KHUGE_CACHE_SIZE 8
+
+/** Mapping header, block returned to caller follows it */
+struct khuge {
+    size_t len;   /* mapping length */
+    int node;     /* requested NUMA node or -1 */
+};
+
+static struct khuge *khuge_cache[KHUGE_CACHE_SIZE];
+static pthread_mutex_t khuge_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct khuge_stats khuge_stats;
+
+/** Reserved hugetlb pages: -1 not checked yet, 0 none, 1 available */
+static int khuge_hugetlb = -1;
+
+
+#define khuge_count(field, bytes) \
+    __atomic_add_fetch(&khuge_stats.field, (bytes), __ATOMIC_RELAXED)
+
+
+/**
+ * Get NUMA node of CPU the calling thread runs on
+ * @return node or -1 if unknown
+ */
+static int khuge_node(void)
+{
+#ifdef SYS_getcpu
+    unsigned int cpu, node;
+
+    if (!syscall(SYS_getcpu, &cpu, &node, NULL))
+        return (int)node;
+#endif
+    return -1;
+}
+
+
+/**
+ * Bind not yet touched mapping to NUMA node
+ * @return 0 if ok
+ */
+static int khuge_bind(void *addr, size_t len, int node)
+{
+#ifdef SYS_mbind
+    unsigned long mask[16];
+
+    if (node < 0 || node >= (int)(sizeof mask * 8))
+        return -1;
+
+    memset(mask, 0, sizeof mask);
+    mask[node / (sizeof(long) * 8)] = 1UL << (node % (sizeof(long) * 8));
+    return syscall(SYS_mbind, addr, len, MPOL_BIND, mask,
+                   sizeof mask * 8, 0) ? -1 : 0;
+#else
+    UNUSED(addr);
+    UNUSED(len);
+    UNUSED(node);
+    return -1;
+#endif
+}
+
+
+/**
+ * Check once whether hugetlb pages are reserved,
+ * so MAP_HUGETLB isn't tried on every allocation
+ */
+static int khuge_hugetlb_available(void)
+{
+    int avail = __atomic_load_n(&khuge_hugetlb, __ATOMIC_RELAXED);
+    unsigned long nr = 0;
+    FILE *f;
+
+    if (avail >= 0)
+        return avail;
+
+    f = fopen("/proc/sys/vm/nr_hugepages", "r");
+    if (f) {
+        if (fscanf(f, "%lu", &nr) != 1)
+            nr = 0;
+        fclose(f);
+    }
+    avail = nr > 0;
+    __atomic_store_n(&khuge_hugetlb, avail, __ATOMIC_RELAXED);
+    return avail;
+}
+
+
+/**
+ * Map region aligned to KHUGE_PAGE_SIZE, so transparent
+ * huge pages can back all of it
+ * @return mapping or MAP_FAILED
+ */
+static void *khuge_map_aligned(size_t len)
+{
+    u8 *p, *start;
+    size_t head;
+
+    p = (u8 *)mmap(NULL, len + KHUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return MAP_FAILED;
+
+    start = (u8 *)(((ulong)p + KHUGE_PAGE_SIZE - 1) & ~(ulong)(KHUGE_PAGE_SIZE - 1));
+    head = start - p;
+    if (head)
+        munmap(p, head);
+    if (KHUGE_PAGE_SIZE - head)
+        munmap(start + len, KHUGE_PAGE_SIZE - head);
+    return start;
+}
+
+
+/**
+ * Take freed mapping of the same length and node
+ */
+static struct khuge *khuge_cache_get(size_t len, int node)
+{
+    struct khuge *h = NULL;
+    int i;
+
+    pthread_mutex_lock(&khuge_lock);
+    for (i = 0; i < KHUGE_CACHE_SIZE; i++) {
+        if (khuge_cache[i] && khuge_cache[i]->len == len &&
+            khuge_cache[i]->node == node) {
+            h = khuge_cache[i];
+            khuge_cache[i] = NULL;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&khuge_lock);
+    return h;
+}
+
+
+/**
+ * Map memory backed by huge pages: reserved hugetlb pages
+ * if available, transparent huge pages otherwise
+ * @param size: block size
+ * @param flags: KHUGE_ flags
+ * @return block or NULL, caller should fall back to malloc()
+ */
+void *khuge_alloc(uint size, uint flags)
+{
+    size_t len = (sizeof(struct khuge) + size + KHUGE_PAGE_SIZE - 1) &
+                 ~(KHUGE_PAGE_SIZE - 1);
+    int node = (flags & KHUGE_NUMA_LOCAL) ? khuge_node() : -1;
+    struct khuge *h;
+    void *p = MAP_FAILED;
+    u8 hugetlb = FALSE;
+
+    h = khuge_cache_get(len, node);
+    if (h) {
+        khuge_count(cached_bytes, len);
+        return h + 1;
+    }
+
+    if (khuge_hugetlb_available()) {
+        p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED)
+            hugetlb = TRUE;
+        else if (errno == ENOMEM) /* reserved pool is used up */
+            __atomic_store_n(&khuge_hugetlb, 0, __ATOMIC_RELAXED);
+    }
+
+    if (p == MAP_FAILED) {
+        p = khuge_map_aligned(len);
+        if (p == MAP_FAILED) {
+            khuge_count(failed_bytes, size);
+            return NULL;
+        }
+        madvise(p, len, MADV_HUGEPAGE);
+    }
+
+    /* pages are not touched yet, so policy applies to all of them */
+    if (node >= 0 && khuge_bind(p, len, node) == 0)
+        khuge_count(numa_bytes, len);
+
+    if (hugetlb)
+        khuge_count(hugetlb_bytes, len);
+    else
+        khuge_count(thp_bytes, len);
+
+    h = (struct khuge *)p;
+    h->len = len;
+    h->node = node;
+    return h + 1;
+}
+
+
+/**
+ * Release block returned by khuge_alloc()
+ */
+void khuge_free(void *ptr)
+{
+    struct khuge *h = (struct khuge *)ptr - 1;
+    int i;
+
+    pthread_mutex_lock(&khuge_lock);
+    for (i = 0; i < KHUGE_CACHE_SIZE; i++) {
+        if (!khuge_cache[i]) {
+            khuge_cache[i] = h;
+            pthread_mutex_unlock(&khuge_lock);
+            return;
+        }
+    }
+    pthread_mutex_unlock(&khuge_lock);
+    munmap(h, h->len);
+}
+
+
+/**
+ * Count block which caller served by malloc() after khuge_alloc() failed
+ * @param size: block size passed to khuge_alloc()
+ */
+void khuge_count_malloc(uint size)
+{
+    khuge_count(malloc_bytes, size);
+}
+
+
+/**
+ * Get bytes served by every backing path
+ */
+void khuge_get_stats(struct khuge_stats *stats)
+{
+    stats->hugetlb_bytes = __atomic_load_n(&khuge_stats.hugetlb_bytes, __ATOMIC_RELAXED);
+    stats->thp_bytes = __atomic_load_n(&khuge_stats.thp_bytes, __ATOMIC_RELAXED);
+    stats->numa_bytes = __atomic_load_n(&khuge_stats.numa_bytes, __ATOMIC_RELAXED);
+    stats->failed_bytes = __atomic_load_n(&khuge_stats.failed_bytes, __ATOMIC_RELAXED);
+    stats->cached_bytes = __atomic_load_n(&khuge_stats.cached_bytes, __ATOMIC_RELAXED);
+    stats->malloc_bytes = __atomic_load_n(&khuge_stats.malloc_bytes, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,42 @@
+#ifndef KHUGE_H_
+#define KHUGE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "types.h"
+
+/** Huge page size assumed for rounding of mappings */
+#define KHUGE_PAGE_SIZE (2UL << 20)
+
+/** Default size from which kref memory is served by huge pages */
+#define KHUGE_THRESHOLD (1U << 20)
+
+/** khuge_alloc() flags */
+#define KHUGE_NUMA_LOCAL (1 << 0) /**< Bind pages to the node of calling thread */
+
+/**
+ * Bytes served by every backing path since start. Mappings count
+ * their length, failed and malloc paths count block size, so
+ * failed_bytes - malloc_bytes were not served at all.
+ */
+struct khuge_stats {
+    unsigned long long hugetlb_bytes; /**< MAP_HUGETLB mappings            */
+    unsigned long long thp_bytes;     /**< Transparent huge page mappings  */
+    unsigned long long numa_bytes;    /**< Bound to local NUMA node        */
+    unsigned long long failed_bytes;  /**< Not served, caller fell back    */
+    unsigned long long cached_bytes;  /**< Reused from freed mappings      */
+    unsigned long long malloc_bytes;  /**< Failed ones served by malloc()  */
+};
+
+void *khuge_alloc(uint size, uint flags);
+void khuge_free(void *ptr);
+void khuge_count_malloc(uint size);
+void khuge_get_stats(struct khuge_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KHUGE_H_ */
@@ -0,0 +1,293 @@
+#define _GNU_SOURCE
+#include "kleak.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <execinfo.h>
+#include <dlfcn.h>
+
+/* live objects table is split to shards to keep lock contention low */
+#define KLEAK_SHARDS 64
+#define KLEAK_BUCKETS 256
+
+/* frames of kleak_alloc() and kralloc_alloc(), both are kept
+ * out of line so the first reported frame is the kref_alloc
+ * entry point called by user code */
+#define KLEAK_SKIP 2
+
+/* sampling interval is drawn from [1, 2 * rate - 1] */
+#define KLEAK_MAX_RATE (1U << 31)
+
+struct kleak_entry {
+    struct kleak_entry *next;
+    const void *mem;
+    uint size;
+    uint depth;
+    void *stack[KLEAK_DEPTH];
+};
+
+struct kleak_shard {
+    pthread_mutex_t lock;
+    struct kleak_entry *buckets[KLEAK_BUCKETS];
+};
+
+/** Outstanding allocations having the same stack */
+struct kleak_site {
+    struct kleak_entry *sample;
+    ulong count;
+    unsigned long long bytes;
+};
+
+static struct kleak_shard kleak_shards[KLEAK_SHARDS];
+static pthread_once_t kleak_once = PTHREAD_ONCE_INIT;
+static uint kleak_rate = 1;
+
+static __thread uint kleak_countdown;
+static __thread uint kleak_seed;
+
+
+static void kleak_init(void)
+{
+    void *stack[1];
+    int i;
+
+    for (i = 0; i < KLEAK_SHARDS; i++)
+        pthread_mutex_init(&kleak_shards[i].lock, NULL);
+    /* first backtrace() call loads unwinder, do it out of allocation path */
+    backtrace(stack, 1);
+}
+
+
+/**
+ * Set sampling: track one of 'rate' allocations on average.
+ * 1 tracks every allocation.
+ */
+void kleak_set_rate(uint rate)
+{
+    pthread_once(&kleak_once, kleak_init);
+    rate = MIN(rate, KLEAK_MAX_RATE);
+    __atomic_store_n(&kleak_rate, rate ? rate : 1, __ATOMIC_RELAXED);
+}
+
+
+static inline uint kleak_hash(const void *mem)
+{
+    return (uint)(((ulong)mem >> 4) * 0x9e3779b1u);
+}
+
+
+/**
+ * Decide if allocation is sampled, random interval keeps
+ * periodic allocation patterns from being missed
+ */
+static int kleak_sampled(void)
+{
+    uint rate = __atomic_load_n(&kleak_rate, __ATOMIC_RELAXED);
+
+    if (rate == 1)
+        return TRUE;
+
+    if (kleak_countdown > 1) {
+        kleak_countdown--;
+        return FALSE;
+    }
+
+    if (!kleak_seed)
+        kleak_seed = (uint)(ulong)&kleak_seed | 1;
+    kleak_seed ^= kleak_seed << 13;
+    kleak_seed ^= kleak_seed >> 17;
+    kleak_seed ^= kleak_seed << 5;
+    kleak_countdown = 1 + kleak_seed % (2 * rate - 1);
+    return TRUE;
+}
+
+
+/**
+ * Record call stack of new memory if it is sampled
+ * @return TRUE if memory is tracked and kleak_free() must be called
+ */
+__attribute__((noinline))
+int kleak_alloc(const void *mem, uint size)
+{
+    void *stack[KLEAK_DEPTH + KLEAK_SKIP];
+    struct kleak_entry *e;
+    struct kleak_shard *shard;
+    uint h;
+    int depth;
+
+    if (!kleak_sampled())
+        return FALSE;
+
+    pthread_once(&kleak_once, kleak_init);
+    e = (struct kleak_entry *)malloc(sizeof *e);
+    if (!e)
+        return FALSE;
+
+    depth = backtrace(stack, KLEAK_DEPTH + KLEAK_SKIP) - KLEAK_SKIP;
+    e->depth = depth > 0 ? depth : 0;
+    memcpy(e->stack, stack + KLEAK_SKIP, e->depth * sizeof(void *));
+    e->mem = mem;
+    e->size = size;
+
+    h = kleak_hash(mem);
+    shard = kleak_shards + h % KLEAK_SHARDS;
+    h = (h / KLEAK_SHARDS) % KLEAK_BUCKETS;
+    pthread_mutex_lock(&shard->lock);
+    e->next = shard->buckets[h];
+    shard->buckets[h] = e;
+    pthread_mutex_unlock(&shard->lock);
+    return TRUE;
+}
+
+
+/**
+ * Forget memory recorded by kleak_alloc()
+ */
+void kleak_free(const void *mem)
+{
+    struct kleak_entry **p, *e = NULL;
+    struct kleak_shard *shard;
+    uint h = kleak_hash(mem);
+
+    shard = kleak_shards + h % KLEAK_SHARDS;
+    h = (h / KLEAK_SHARDS) % KLEAK_BUCKETS;
+    pthread_mutex_lock(&shard->lock);
+    for (p = shard->buckets + h; *p; p = &(*p)->next) {
+        if ((*p)->mem == mem) {
+            e = *p;
+            *p = e->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&shard->lock);
+    free(e);
+}
+
+
+static int kleak_stack_cmp(const void *p1, const void *p2)
+{
+    const struct kleak_entry *e1 = (const struct kleak_entry *)p1;
+    const struct kleak_entry *e2 = (const struct kleak_entry *)p2;
+
+    if (e1->depth != e2->depth)
+        return e1->depth < e2->depth ? -1 : 1;
+    return memcmp(e1->stack, e2->stack, e1->depth * sizeof(void *));
+}
+
+
+static int kleak_site_cmp(const void *p1, const void *p2)
+{
+    const struct kleak_site *s1 = (const struct kleak_site *)p1;
+    const struct kleak_site *s2 = (const struct kleak_site *)p2;
+
+    if (s1->bytes != s2->bytes)
+        return s1->bytes < s2->bytes ? 1 : -1;
+    return s1->count < s2->count ? 1 : s1->count > s2->count ? -1 : 0;
+}
+
+
+static void kleak_print_frame(FILE *f, void *addr)
+{
+    Dl_info info;
+
+    memset(&info, 0, sizeof info);
+    if (dladdr(addr, &info) && info.dli_sname)
+        fprintf(f, "    %p %s+0x%lx (%s)\n", addr, info.dli_sname,
+                (ulong)((char *)addr - (char *)info.dli_saddr),
+                info.dli_fname);
+    else if (info.dli_fname)
+        fprintf(f, "    %p %s+0x%lx\n", addr, info.dli_fname,
+                (ulong)((char *)addr - (char *)info.dli_fbase));
+    else
+        fprintf(f, "    %p\n", addr);
+}
+
+
+/**
+ * Copy all tracked entries, shards are locked one by one
+ * so allocations keep working during report
+ * @return number of entries in 'copy'
+ */
+static uint kleak_snapshot(struct kleak_entry **copy)
+{
+    struct kleak_entry *entries = NULL, *tmp, *e;
+    struct kleak_shard *shard;
+    uint n = 0, max = 0, i, b;
+
+    for (i = 0; i < KLEAK_SHARDS; i++) {
+        shard = kleak_shards + i;
+        pthread_mutex_lock(&shard->lock);
+        for (b = 0; b < KLEAK_BUCKETS; b++) {
+            for (e = shard->buckets[b]; e; e = e->next) {
+                if (n == max) {
+                    max = max ? max * 2 : 256;
+                    tmp = (struct kleak_entry *)realloc(entries,
+                                                        max * sizeof *tmp);
+                    if (!tmp) {
+                        pthread_mutex_unlock(&shard->lock);
+                        *copy = entries;
+                        return n;
+                    }
+                    entries = tmp;
+                }
+                entries[n++] = *e;
+            }
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+    *copy = entries;
+    return n;
+}
+
+
+/**
+ * Print outstanding tracked allocations grouped by call stack,
+ * sites holding most bytes first
+ * @param max_sites: number of sites to print, 0 for all
+ */
+void kleak_report(FILE *f, uint max_sites)
+{
+    struct kleak_entry *entries;
+    struct kleak_site *sites = NULL;
+    uint nr_entries, nr_sites = 0, i, j;
+    unsigned long long total_bytes = 0;
+    uint rate = __atomic_load_n(&kleak_rate, __ATOMIC_RELAXED);
+
+    pthread_once(&kleak_once, kleak_init);
+    nr_entries = kleak_snapshot(&entries);
+    if (nr_entries) {
+        qsort(entries, nr_entries, sizeof *entries, kleak_stack_cmp);
+        sites = (struct kleak_site *)malloc(nr_entries * sizeof *sites);
+    }
+
+    for (i = 0; sites && i < nr_entries; i++) {
+        if (!nr_sites || kleak_stack_cmp(sites[nr_sites - 1].sample,
+                                         entries + i)) {
+            sites[nr_sites].sample = entries + i;
+            sites[nr_sites].count = 0;
+            sites[nr_sites].bytes = 0;
+            nr_sites++;
+        }
+        sites[nr_sites - 1].count++;
+        sites[nr_sites - 1].bytes += entries[i].size;
+        total_bytes += entries[i].size;
+    }
+    if (nr_sites)
+        qsort(sites, nr_sites, sizeof *sites, kleak_site_cmp);
+
+    fprintf(f, "kmem leak report: %u tracked objects, %llu bytes in %u sites, "
+            "sampling 1/%u\n", nr_entries, total_bytes, nr_sites, rate);
+    for (i = 0; i < nr_sites && (!max_sites || i < max_sites); i++) {
+        fprintf(f, "#%u: %lu objects, %llu bytes", i + 1, sites[i].count,
+                sites[i].bytes);
+        if (rate > 1)
+            fprintf(f, " (estimated %llu objects, %llu bytes)",
+                    (unsigned long long)sites[i].count * rate,
+                    sites[i].bytes * rate);
+        fprintf(f, "\n");
+        for (j = 0; j < sites[i].sample->depth; j++)
+            kleak_print_frame(f, sites[i].sample->stack[j]);
+    }
+    free(sites);
+    free(entries);
+}
@@ -0,0 +1,23 @@
+#ifndef KLEAK_H_
+#define KLEAK_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include "types.h"
+
+/** Frames captured per allocation site */
+#define KLEAK_DEPTH 12
+
+void kleak_set_rate(uint rate);
+int kleak_alloc(const void *mem, uint size);
+void kleak_free(const void *mem);
+void kleak_report(FILE *f, uint max_sites);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KLEAK_H_ */
@@ -0,0 +1,382 @@
+#define _GNU_SOURCE
+#include "kprof.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <execinfo.h>
+
+/* frames of kprof_alloc() and kralloc_alloc() */
+#define KPROF_SKIP 2
+
+#define KPROF_BUCKETS 4096
+#define KPROF_OBJS 4096
+
+/** Samples having the same call stack */
+struct kprof_bucket {
+    struct kprof_bucket *next;
+    uint hash;
+    uint depth;
+    void *stack[KPROF_DEPTH];
+    unsigned long long allocs;
+    unsigned long long alloc_bytes;
+    unsigned long long frees;
+    unsigned long long free_bytes;
+};
+
+/** Live sampled memory */
+struct kprof_obj {
+    struct kprof_obj *next;
+    const void *mem;
+    uint size;
+    struct kprof_bucket *bucket;
+};
+
+static struct kprof_bucket *kprof_buckets[KPROF_BUCKETS];
+static struct kprof_obj *kprof_objs[KPROF_OBJS];
+static pthread_mutex_t kprof_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint kprof_rate = KPROF_RATE;
+
+static __thread long long kprof_bytes_left;
+static __thread uint kprof_seed;
+
+static int kprof_pipe[2] = {-1, -1};
+static char *kprof_prefix;
+
+
+/**
+ * Set mean distance between samples, changes
+ * are applied after next sample of every thread
+ */
+void kprof_set_rate(uint rate)
+{
+    __atomic_store_n(&kprof_rate, rate ? rate : 1, __ATOMIC_RELAXED);
+}
+
+
+/**
+ * Draw distance to next sample from exponential distribution,
+ * so every allocated byte has the same chance to be sampled
+ */
+static long long kprof_next_sample(void)
+{
+    uint rate = __atomic_load_n(&kprof_rate, __ATOMIC_RELAXED);
+    double u;
+
+    if (rate == 1)
+        return 1;
+
+    if (!kprof_seed)
+        kprof_seed = (uint)(ulong)&kprof_seed | 1;
+    kprof_seed ^= kprof_seed << 13;
+    kprof_seed ^= kprof_seed >> 17;
+    kprof_seed ^= kprof_seed << 5;
+
+    u = ((kprof_seed >> 8) + 1) / (double)(1 << 24);
+    return (long long)(-log(u) * rate) + 1;
+}
+
+
+static inline uint kprof_hash_ptr(const void *mem)
+{
+    return (uint)(((ulong)mem >> 4) * 0x9e3779b1u);
+}
+
+
+static uint kprof_hash_stack(void **stack, uint depth)
+{
+    uint h = 0, i;
+
+    for (i = 0; i < depth; i++)
+        h = (h ^ (uint)(ulong)stack[i]) * 0x01000193u;
+    return h;
+}
+
+
+/**
+ * Get bucket of call stack, create it if needed.
+ * Called with kprof_lock held.
+ */
+static struct kprof_bucket *kprof_bucket(void **stack, uint depth)
+{
+    uint h = kprof_hash_stack(stack, depth);
+    struct kprof_bucket **head = kprof_buckets + h % KPROF_BUCKETS;
+    struct kprof_bucket *b;
+
+    for (b = *head; b; b = b->next)
+        if (b->hash == h && b->depth == depth &&
+            !memcmp(b->stack, stack, depth * sizeof(void *)))
+            return b;
+
+    b = (struct kprof_bucket *)calloc(1, sizeof *b);
+    if (!b)
+        return NULL;
+    b->hash = h;
+    b->depth = depth;
+    memcpy(b->stack, stack, depth * sizeof(void *));
+    b->next = *head;
+    *head = b;
+    return b;
+}
+
+
+/**
+ * Account allocated bytes, sample memory when sampling distance is passed
+ * @return TRUE if memory is sampled and kprof_free() must be called
+ */
+__attribute__((noinline))
+int kprof_alloc(const void *mem, uint size)
+{
+    void *stack[KPROF_DEPTH + KPROF_SKIP];
+    struct kprof_bucket *b;
+    struct kprof_obj *obj;
+    int depth;
+
+    if (!kprof_bytes_left)
+        kprof_bytes_left = kprof_next_sample();
+
+    kprof_bytes_left -= size;
+    if (kprof_bytes_left > 0)
+        return FALSE;
+    kprof_bytes_left = kprof_next_sample();
+
+    obj = (struct kprof_obj *)malloc(sizeof *obj);
+    if (!obj)
+        return FALSE;
+
+    depth = backtrace(stack, KPROF_DEPTH + KPROF_SKIP) - KPROF_SKIP;
+    if (depth < 0)
+        depth = 0;
+
+    pthread_mutex_lock(&kprof_lock);
+    b = kprof_bucket(stack + KPROF_SKIP, depth);
+    if (!b) {
+        pthread_mutex_unlock(&kprof_lock);
+        free(obj);
+        return FALSE;
+    }
+    b->allocs++;
+    b->alloc_bytes += size;
+
+    obj->mem = mem;
+    obj->size = size;
+    obj->bucket = b;
+    obj->next = kprof_objs[kprof_hash_ptr(mem) % KPROF_OBJS];
+    kprof_objs[kprof_hash_ptr(mem) % KPROF_OBJS] = obj;
+    pthread_mutex_unlock(&kprof_lock);
+    return TRUE;
+}
+
+
+/**
+ * Account release of memory sampled by kprof_alloc()
+ */
+void kprof_free(const void *mem)
+{
+    struct kprof_obj **p, *obj = NULL;
+
+    pthread_mutex_lock(&kprof_lock);
+    for (p = kprof_objs + kprof_hash_ptr(mem) % KPROF_OBJS; *p; p = &(*p)->next) {
+        if ((*p)->mem == mem) {
+            obj = *p;
+            *p = obj->next;
+            obj->bucket->frees++;
+            obj->bucket->free_bytes += obj->size;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&kprof_lock);
+    free(obj);
+}
+
+
+static void kprof_write_maps(FILE *f)
+{
+    char line[512];
+    FILE *maps = fopen("/proc/self/maps", "r");
+
+    fprintf(f, "\nMAPPED_LIBRARIES:\n");
+    if (!maps)
+        return;
+    while (fgets(line, sizeof line, maps))
+        fputs(line, f);
+    fclose(maps);
+}
+
+
+/**
+ * Write heap profile in legacy pprof text format:
+ * in-use and total sampled objects per call stack,
+ * pprof scales samples back by the heap_v2 rate
+ * @return 0 if ok
+ */
+int kprof_write(FILE *f)
+{
+    struct kprof_bucket *b;
+    unsigned long long inuse = 0, inuse_bytes = 0, allocs = 0, alloc_bytes = 0;
+    uint i, j;
+
+    pthread_mutex_lock(&kprof_lock);
+    for (i = 0; i < KPROF_BUCKETS; i++) {
+        for (b = kprof_buckets[i]; b; b = b->next) {
+            inuse += b->allocs - b->frees;
+            inuse_bytes += b->alloc_bytes - b->free_bytes;
+            allocs += b->allocs;
+            alloc_bytes += b->alloc_bytes;
+        }
+    }
+
+    fprintf(f, "heap profile: %6llu: %8llu [%6llu: %8llu] @ heap_v2/%u\n",
+            inuse, inuse_bytes, allocs, alloc_bytes,
+            __atomic_load_n(&kprof_rate, __ATOMIC_RELAXED));
+
+    for (i = 0; i < KPROF_BUCKETS; i++) {
+        for (b = kprof_buckets[i]; b; b = b->next) {
+            fprintf(f, "%6llu: %8llu [%6llu: %8llu] @", b->allocs - b->frees,
+                    b->alloc_bytes - b->free_bytes, b->allocs, b->alloc_bytes);
+            for (j = 0; j < b->depth; j++)
+                fprintf(f, " %p", b->stack[j]);
+            fprintf(f, "\n");
+        }
+    }
+    pthread_mutex_unlock(&kprof_lock);
+
+    kprof_write_maps(f);
+    return ferror(f) ? -1 : 0;
+}
+
+
+/**
+ * Write heap profile to file
+ * @return 0 if ok
+ */
+int kprof_dump(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    int rc;
+
+    if (!f) {
+        print_e("can't open %s: %d\n", path, errno);
+        return -1;
+    }
+    rc = kprof_write(f);
+    if (fclose(f))
+        rc = -1;
+    return rc;
+}
+
+
+static void kprof_signal_handler(int signo)
+{
+    int saved_errno = errno;
+    char c = 0;
+
+    UNUSED(signo);
+    if (write(kprof_pipe[1], &c, 1) < 0) {
+        /* dump already requested */
+    }
+    errno = saved_errno;
+}
+
+
+/**
+ * Write profiles requested by signal handler,
+ * signal handler itself can't use stdio
+ */
+static void *kprof_dump_thread(void *arg)
+{
+    char path[4096];
+    uint seq = 0;
+    ssize_t n;
+    char c;
+
+    UNUSED(arg);
+    for (;;) {
+        n = read(kprof_pipe[0], &c, 1);
+        if (n > 0) {
+            snprintf(path, sizeof path, "%s.%d.%04u.heap", kprof_prefix,
+                     (int)getpid(), seq++);
+            kprof_dump(path);
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            break;
+        }
+    }
+    return NULL;
+}
+
+
+/**
+ * Undo partial kprof_dump_on_signal() setup
+ */
+static void kprof_signal_reset(void)
+{
+    if (kprof_pipe[0] >= 0)
+        close(kprof_pipe[0]);
+    if (kprof_pipe[1] >= 0)
+        close(kprof_pipe[1]);
+    kprof_pipe[0] = kprof_pipe[1] = -1;
+    free(kprof_prefix);
+    kprof_prefix = NULL;
+}
+
+
+/**
+ * Dump heap profile to '<prefix>.<pid>.<seq>.heap' on every signal
+ * @param signo: signal, e.g. SIGUSR2
+ * @param prefix: profile path prefix
+ * @return 0 if ok
+ */
+int kprof_dump_on_signal(int signo, const char *prefix)
+{
+    struct sigaction sa;
+    pthread_t thread;
+    sigset_t all, old;
+    int rc;
+
+    if (kprof_pipe[0] >= 0) {
+        print_e("profile signal is already set\n");
+        return -1;
+    }
+
+    kprof_prefix = strdup(prefix);
+    if (!kprof_prefix || pipe2(kprof_pipe, O_CLOEXEC | O_NONBLOCK)) {
+        print_e("can't set up profile signal\n");
+        kprof_signal_reset();
+        return -1;
+    }
+    /* reader blocks, writer in signal handler must not */
+    fcntl(kprof_pipe[0], F_SETFL, 0);
+
+    /* dump thread should not take the signal itself */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    rc = pthread_create(&thread, NULL, kprof_dump_thread, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (rc) {
+        print_e("can't create profile dump thread\n");
+        kprof_signal_reset();
+        return -1;
+    }
+
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = kprof_signal_handler;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(signo, &sa, NULL)) {
+        print_e("can't set handler of signal %d\n", signo);
+        /* dump thread exits on end of file */
+        close(kprof_pipe[1]);
+        kprof_pipe[1] = -1;
+        pthread_join(thread, NULL);
+        kprof_signal_reset();
+        return -1;
+    }
+    pthread_detach(thread);
+    return 0;
+}
@@ -0,0 +1,28 @@
+#ifndef KPROF_H_
+#define KPROF_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include "types.h"
+
+/** Default mean distance between samples in allocated bytes */
+#define KPROF_RATE (512 * 1024)
+
+/** Frames captured per sample */
+#define KPROF_DEPTH 32
+
+void kprof_set_rate(uint rate);
+int kprof_alloc(const void *mem, uint size);
+void kprof_free(const void *mem);
+int kprof_write(FILE *f);
+int kprof_dump(const char *path);
+int kprof_dump_on_signal(int signo, const char *prefix);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KPROF_H_ */
@@ -20,3 +20,121 @@ int kref_put(struct kref *kref, void (*release)(struct kref *kref))
     return 0;
 }
 
+/**
+ * Thread safe variant of kref_get()
+ */
+void kref_get_atomic(struct kref *kref)
+{
+    __atomic_add_fetch(&kref->refcount, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Thread safe variant of kref_put(). Final put synchronizes
+ * with all previous puts, so release() sees every write made
+ * by threads which dropped their references.
+ */
+int kref_put_atomic(struct kref *kref, void (*release)(struct kref *kref))
+{
+    if (__atomic_sub_fetch(&kref->refcount, 1, __ATOMIC_RELEASE))
+        return 0;
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    release(kref);
+    return 1;
+}
+
+unsigned int kref_read(const struct kref *kref)
+{
+    return __atomic_load_n(&kref->refcount, __ATOMIC_RELAXED);
+}
+
+
+static unsigned int kref_last_thread_id;
+static __thread unsigned int kref_self_id
+    __attribute__((tls_model("initial-exec")));
+
+static inline unsigned int kref_self(void)
+{
+    if (__builtin_expect(!kref_self_id, 0))
+        kref_self_id = __atomic_add_fetch(&kref_last_thread_id, 1,
+                                          __ATOMIC_RELAXED);
+    return kref_self_id;
+}
+
+/**
+ * Get id of current thread, ids are never reused
+ */
+unsigned int kref_thread_id(void)
+{
+    return kref_self();
+}
+
+static inline int kref_is_owner(const struct kref_biased *kref)
+{
+    return __atomic_load_n(&kref->owner, __ATOMIC_RELAXED) == kref_self();
+}
+
+/**
+ * Init biased counter owned by current thread
+ */
+void kref_biased_init(struct kref_biased *kref)
+{
+    kref->kref.refcount = 1;
+    kref->shared = 1;
+    kref->owner = kref_self();
+}
+
+void kref_get_biased(struct kref_biased *kref)
+{
+    if (kref_is_owner(kref)) {
+        /* owner gets reference back after dropping all its own */
+        if (kref->kref.refcount++)
+            return;
+    }
+    __atomic_add_fetch(&kref->shared, 1, __ATOMIC_RELAXED);
+}
+
+int kref_put_biased(struct kref_biased *kref, void (*release)(struct kref *kref))
+{
+    if (kref_is_owner(kref) && --kref->kref.refcount)
+        return 0;
+
+    if (__atomic_sub_fetch(&kref->shared, 1, __ATOMIC_RELEASE))
+        return 0;
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    release(&kref->kref);
+    return 1;
+}
+
+/**
+ * Move owner thread references to shared counter.
+ * Must be called by the owner before a reference is passed
+ * to another thread, after that all threads count atomically.
+ */
+void kref_merge_biased(struct kref_biased *kref)
+{
+    unsigned int cnt;
+
+    if (!kref_is_owner(kref))
+        return;
+
+    cnt = kref->kref.refcount;
+    kref->kref.refcount = 0;
+    __atomic_store_n(&kref->owner, KREF_NO_OWNER, __ATOMIC_RELAXED);
+    /* the owner holds one shared reference while cnt is not zero */
+    if (cnt > 1)
+        __atomic_add_fetch(&kref->shared, cnt - 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Get approximate number of references,
+ * exact only for the owner thread or after merge
+ */
+unsigned int kref_read_biased(const struct kref_biased *kref)
+{
+    unsigned int shared = __atomic_load_n(&kref->shared, __ATOMIC_RELAXED);
+    unsigned int owned = kref_is_owner(kref) ? kref->kref.refcount : 0;
+
+    return owned ? owned + shared - 1 : shared;
+}
@@ -9,9 +9,33 @@ struct kref {
     unsigned int refcount;
 };
 
+/** Owner id of biased counter merged into the shared one */
+#define KREF_NO_OWNER 0
+
+/**
+ * Biased reference counter. References of the owner thread are
+ * counted in 'kref' without atomic operations and hold a single
+ * reference on 'shared', other threads work with 'shared' atomically.
+ */
+struct kref_biased {
+    struct kref kref;     /**< Owner thread counter */
+    unsigned int shared;  /**< Shared counter        */
+    unsigned int owner;   /**< Owner thread id       */
+};
+
 void kref_init(struct kref *kref);
 void kref_get(struct kref *kref);
 int kref_put(struct kref *kref, void (*release) (struct kref *kref));
+void kref_get_atomic(struct kref *kref);
+int kref_put_atomic(struct kref *kref, void (*release) (struct kref *kref));
+unsigned int kref_read(const struct kref *kref);
+
+unsigned int kref_thread_id(void);
+void kref_biased_init(struct kref_biased *kref);
+void kref_get_biased(struct kref_biased *kref);
+int kref_put_biased(struct kref_biased *kref, void (*release) (struct kref *kref));
+void kref_merge_biased(struct kref_biased *kref);
+unsigned int kref_read_biased(const struct kref_biased *kref);
 
 #ifdef __cplusplus
 }
@@ -1,50 +1,233 @@
 #include "list.h"
 #include "kref.h"
 #include "kref_alloc.h"
+#include "kslab.h"
+#include "khuge.h"
+#include "kstat.h"
+#include "kleak.h"
+#include "kprof.h"
+#include "ktrace.h"
 #include <stdarg.h>
 #include <stdlib.h>
 
 struct kralloc {
-    char magic[8];
-    struct list list;
-    struct le le;
-    struct kref kref;
-    struct kralloc *linked_mem;
-    u8 shift_size;
+    u32 tag;
     uint size;
+    struct kref_biased kref;
+    u8 shift_size;
+    u8 slab_class; /* 0 if allocated by malloc() */
+    u16 slab_owner;
+    u16 flags;
+    u8 stat_class; /* kstat size class of whole block */
+    struct kralloc_link *link; /* NULL until memory takes part in linking */
     void (*destructor)(void *mem);
 };
 
+/* Link record, materialized only for memories which are linked,
+ * have linked memories or own a region */
+struct kralloc_link {
+    struct list list;       /* root: linked memories */
+    struct le le;           /* child: entry of root list */
+    struct kralloc *root;   /* child: root memory */
+    struct kregion *region; /* root: bump allocator for linked memory */
+};
 
-static void k_destructor(struct kref *kref)
+#define KRALLOC_TAG 0x6b72616c /* "kral" */
+#define KRALLOC_TAG_FREE 0x66726565 /* "free" */
+
+/* struct kralloc flags */
+#define KRALLOC_F_ATOMIC (1 << 0) /* kref is shared between threads */
+#define KRALLOC_F_BIASED (1 << 1) /* kref is biased to allocating thread */
+#define KRALLOC_F_REGION (1 << 2) /* carved from root memory region */
+#define KRALLOC_F_LINKED (1 << 3) /* linked to root memory */
+#define KRALLOC_F_LINK_INLINE (1 << 4) /* link record is not malloc()ed */
+#define KRALLOC_F_HUGE (1 << 5) /* block is served by khuge_alloc() */
+#define KRALLOC_F_STATS (1 << 6) /* counted by kstat_alloc() */
+#define KRALLOC_F_LEAK (1 << 7) /* call stack recorded by kleak_alloc() */
+#define KRALLOC_F_PROF (1 << 8) /* sampled by kprof_alloc() */
+#define KRALLOC_F_TRACE (1 << 9) /* recorded by ktrace_alloc() */
+
+#define KREGION_ALIGN 16
+#define kregion_align(x) (((ulong)(x) + KREGION_ALIGN - 1) & ~(ulong)(KREGION_ALIGN - 1))
+
+/* Chunk of region memory. The first chunk is placed
+ * in the root memory block, next ones are malloc()ed */
+struct kregion {
+    struct kregion *next; /* previous chunk */
+    u8 *pos;              /* first free byte */
+    u8 *end;
+    uint chunk_size;
+};
+
+static uint kralloc_flags;
+static uint kralloc_huge_threshold = KHUGE_THRESHOLD;
+
+
+#ifdef KMEM_DEBUG
+/**
+ * Full memory descriptor validation for debug builds
+ */
+static int kralloc_check(struct kralloc *a, const char *func)
 {
-    struct kralloc *a = (struct kralloc *)container_of(kref, struct kralloc, kref);
-    struct kralloc *a_root;
-    struct le *le, *safe_le;
+    struct kralloc *a_root = a;
 
-    /* find root memory descriptor */
-    a_root = a;
-    while(a_root->linked_mem) {
-        a_root = a_root->linked_mem;
+    if ((ulong)(a + 1) < 4096) {
+        print_e("%s(): NULL kref memory\n", func);
+        return FALSE;
+    }
 
-        if(strcmp(a_root->magic, "kralloc") != 0)
-            break;
+    if (a->tag == KRALLOC_TAG_FREE) {
+        print_e("%s(): %p used after free\n", func, (void *)(a + 1));
+        return FALSE;
     }
 
-    /* free all linked memories */
-    LIST_FOREACH_SAFE(&a_root->list, le, safe_le) {
-        a = (struct kralloc *)list_ledata(le);
-        list_unlink(le);
-        if (a->destructor)
-            a->destructor(a + 1);
-        strcpy(a->magic, "\0");
-        free((u8 *)a - a->shift_size);
+    if (a->tag != KRALLOC_TAG) {
+        print_e("%s(): %p is not kref memory\n", func, (void *)(a + 1));
+        return FALSE;
+    }
+
+    if (a->slab_class >= KSLAB_NR_CLASSES) {
+        print_e("%s(): %p has corrupted descriptor\n", func, (void *)(a + 1));
+        return FALSE;
+    }
+
+    if (a->flags & KRALLOC_F_LINKED) {
+        a_root = a->link->root;
+        if (a_root->tag != KRALLOC_TAG || (a_root->flags & KRALLOC_F_LINKED)) {
+            print_e("%s(): %p linked to corrupted root\n", func, (void *)(a + 1));
+            return FALSE;
+        }
+    }
+
+    if (!a_root->kref.kref.refcount && !a_root->kref.shared) {
+        print_e("%s(): %p has no references\n", func, (void *)(a + 1));
+        return FALSE;
+    }
+    return TRUE;
+}
+#define kralloc_valid(a) kralloc_check((a), __func__)
+#elif defined(KMEM_NO_CHECK)
+#define kralloc_valid(a) TRUE
+#else
+#define kralloc_valid(a) ((a)->tag == KRALLOC_TAG)
+#endif
+
+
+/**
+ * Select allocator backend. Must be called before first allocation,
+ * memory allocated before is still freed correctly.
+ * @param flags: KRALLOC_ flags
+ * @return 0 if ok
+ */
+int kref_alloc_init(uint flags)
+{
+    kralloc_flags = flags;
+    return 0;
+}
+
+
+/**
+ * Set size from which memory is backed by huge pages
+ * when KRALLOC_HUGE_PAGES is enabled
+ * @param size: block size, KHUGE_THRESHOLD by default
+ */
+void kref_alloc_huge_threshold(uint size)
+{
+    kralloc_huge_threshold = size;
+}
+
+
+/**
+ * Get root memory descriptor. Linked memories always
+ * point directly to the root, so no chain walking needed.
+ */
+static inline struct kralloc *kralloc_root(struct kralloc *a)
+{
+    return (a->flags & KRALLOC_F_LINKED) ? a->link->root : a;
+}
+
+
+/**
+ * Get link record, allocate it on first use
+ */
+static struct kralloc_link *kralloc_link(struct kralloc *a)
+{
+    if (!a->link)
+        a->link = (struct kralloc_link *)calloc(1, sizeof *a->link);
+    return a->link;
+}
+
+
+/**
+ * Free region chunks except the one placed in root memory block
+ */
+static void kregion_release(struct kregion *r)
+{
+    struct kregion *next;
+
+    while (r && r->next) {
+        next = r->next;
+        free(r);
+        r = next;
+    }
+}
+
+
+/**
+ * Return raw memory block to the backend it was taken from
+ */
+static void kralloc_free(struct kralloc *a)
+{
+    void *ptr = (u8 *)a - a->shift_size;
+
+    if (a->flags & KRALLOC_F_STATS)
+        kstat_free(a->size, a->stat_class, a->destructor);
+    if (a->flags & KRALLOC_F_LEAK)
+        kleak_free(a);
+    if (a->flags & KRALLOC_F_PROF)
+        kprof_free(a);
+    if (a->flags & KRALLOC_F_TRACE)
+        ktrace_free(a);
+
+    if (a->link) {
+        kregion_release(a->link->region);
+        if (!(a->flags & KRALLOC_F_LINK_INLINE))
+            free(a->link);
+    }
+    a->tag = KRALLOC_TAG_FREE;
+    if (a->slab_class)
+        kslab_free(ptr, a->slab_class, a->slab_owner);
+    else if (a->flags & KRALLOC_F_HUGE)
+        khuge_free(ptr);
+    else
+        free(ptr);
+}
+
+
+static void k_destructor(struct kref *kref)
+{
+    struct kralloc *a = (struct kralloc *)container_of(kref, struct kralloc, kref.kref);
+    struct kralloc *a_root;
+    struct le *le, *safe_le;
+
+    a_root = kralloc_root(a);
+
+    /* free all linked memories, region memories
+     * are listed only if they have destructor */
+    if (a_root->link) {
+        LIST_FOREACH_SAFE(&a_root->link->list, le, safe_le) {
+            a = (struct kralloc *)list_ledata(le);
+            list_unlink(le);
+            if (a->destructor)
+                a->destructor(a + 1);
+            if (!(a->flags & KRALLOC_F_REGION))
+                kralloc_free(a);
+        }
     }
     /* free root memory */
     if (a_root->destructor)
         a_root->destructor(a_root + 1);
-    strcpy(a_root->magic, "\0");
-    free((u8 *)a_root - a_root->shift_size);
+    kralloc_free(a_root);
 }
 
 
@@ -88,26 +271,105 @@ static inline int fls(int x)
 #include <strings.h>
 #endif
 
+static inline void kralloc_get(struct kralloc *a)
+{
+    if (a->flags & KRALLOC_F_BIASED)
+        kref_get_biased(&a->kref);
+    else if (a->flags & KRALLOC_F_ATOMIC)
+        kref_get_atomic(&a->kref.kref);
+    else
+        kref_get(&a->kref.kref);
+}
+
+
+static inline int kralloc_put(struct kralloc *a)
+{
+    if (a->flags & KRALLOC_F_BIASED)
+        return kref_put_biased(&a->kref, k_destructor);
+    if (a->flags & KRALLOC_F_ATOMIC)
+        return kref_put_atomic(&a->kref.kref, k_destructor);
+    return kref_put(&a->kref.kref, k_destructor);
+}
+
+
+static int kralloc_link_to(struct kralloc *a_new, struct kralloc *a_root);
+
+
 /**
- * Allocate aligned memory
- * @param size: needed memory size
- * @param flags: kmalloc flags
- * @param align: align divider (4, 8, 16 ant etc.) or 0 if no align
- * @param destructor: destructor for this memory
+ * Fill memory descriptor of new root memory
  */
-void *kref_alloc_aligned(int size, uint align, void (*destructor)(void *mem))
+static void kralloc_init(struct kralloc *a, uint size,
+                         void (*destructor)(void *mem))
+{
+    a->tag = KRALLOC_TAG;
+    a->size = size;
+    a->link = NULL;
+    a->destructor = destructor;
+    a->flags = 0;
+    if (kralloc_flags & KRALLOC_BIASED_REF) {
+        a->flags |= KRALLOC_F_BIASED;
+        kref_biased_init(&a->kref);
+    } else {
+        if (kralloc_flags & KRALLOC_ATOMIC_REF)
+            a->flags |= KRALLOC_F_ATOMIC;
+        kref_init(&a->kref.kref);
+        /* unused, but read by debug validation */
+        a->kref.shared = 0;
+        a->kref.owner = 0;
+    }
+}
+
+
+/**
+ * Place link record to the extra space behind memory payload
+ */
+static struct kralloc_link *kralloc_link_inline(struct kralloc *a)
+{
+    a->link = (struct kralloc_link *)kregion_align((u8 *)(a + 1) + a->size);
+    memset(a->link, 0, sizeof *a->link);
+    a->flags |= KRALLOC_F_LINK_INLINE;
+    return a->link;
+}
+
+
+/**
+ * Allocate aligned memory followed by 'extra' bytes.
+ * Kept out of line: kleak and kprof skip its frame in call stacks.
+ */
+__attribute__((noinline))
+static struct kralloc *kralloc_alloc(uint size, uint align, uint extra,
+                                     void (*destructor)(void *mem))
 {
     struct kralloc *a;
     void *ptr, *end_ptr, *aligned_ptr;
-
-    u8 shift;
+    uint total;
+    int cls = 0;
+    u16 owner = 0;
+    u8 shift, huge = FALSE;
 
     /* fixed align value if incorrect */
     if (align) {
         shift = (fls(align) - 1);
         align = 1 << shift;
     }
-    ptr = malloc(sizeof(struct kralloc) + size + align);
+    total = sizeof(struct kralloc) + size + align + extra;
+    if (kralloc_flags & KRALLOC_SLAB)
+        cls = kslab_class(total);
+
+    if (cls) {
+        ptr = kslab_alloc(cls, &owner);
+    } else {
+        if ((kralloc_flags & KRALLOC_HUGE_PAGES) &&
+            total >= kralloc_huge_threshold) {
+            ptr = khuge_alloc(total, (kralloc_flags & KRALLOC_NUMA_LOCAL) ?
+                                     KHUGE_NUMA_LOCAL : 0);
+            huge = ptr != NULL;
+            if (!huge && (ptr = malloc(total)))
+                khuge_count_malloc(total);
+        } else {
+            ptr = malloc(total);
+        }
+    }
     if (!ptr)
         return ptr;
 
@@ -119,14 +381,154 @@ void *kref_alloc_aligned(int size, uint align, void (*destructor)(void *mem))
 
     a = (struct kralloc *)((u8 *)aligned_ptr - sizeof(*a));
     a->shift_size = ((u8 *)a - (u8 *)ptr);
-    a->size = size;
-    strcpy(a->magic, "kralloc");
-    memset(&a->list, 0, sizeof a->list);
-    memset(&a->le, 0, sizeof a->le);
-    a->destructor = destructor;
-    kref_init(&a->kref);
-    a->linked_mem = NULL; /* mark as root memory */
+    a->slab_class = cls;
+    a->slab_owner = owner;
+    kralloc_init(a, size, destructor);
+    if (huge)
+        a->flags |= KRALLOC_F_HUGE;
+    /* memories carved from regions are not counted */
+    if (kralloc_flags & KRALLOC_STATS) {
+        /* the class slabs serve for the block, not for the payload */
+        a->stat_class = cls ? cls : kslab_class(total);
+        a->flags |= KRALLOC_F_STATS;
+        kstat_alloc(size, a->stat_class, destructor);
+    }
+    if ((kralloc_flags & KRALLOC_LEAK_CHECK) && kleak_alloc(a, size))
+        a->flags |= KRALLOC_F_LEAK;
+    if ((kralloc_flags & KRALLOC_HEAP_PROF) && kprof_alloc(a, size))
+        a->flags |= KRALLOC_F_PROF;
+    if ((kralloc_flags & KRALLOC_TRACE) && ktrace_alloc(a, size, align))
+        a->flags |= KRALLOC_F_TRACE;
+    return a;
+}
+
+
+/**
+ * Allocate aligned memory
+ * @param size: needed memory size
+ * @param flags: kmalloc flags
+ * @param align: align divider (4, 8, 16 ant etc.) or 0 if no align
+ * @param destructor: destructor for this memory
+ */
+void *kref_alloc_aligned(int size, uint align, void (*destructor)(void *mem))
+{
+    struct kralloc *a = kralloc_alloc(size, align, 0, destructor);
+    if (!a)
+        return NULL;
+
+    return (void *)(a + 1);
+}
+
+
+/**
+ * Allocate root memory owning a region for linked memories.
+ * Memories allocated by kref_alloc_in() are carved from the region
+ * and released all at once together with the root memory.
+ * @param size: needed memory size
+ * @param region_size: size of first region chunk,
+ *                     next chunks are added on demand
+ * @param destructor: destructor for this memory
+ */
+void *kref_alloc_region(uint size, uint region_size,
+                        void (*destructor)(void *mem))
+{
+    struct kralloc *a;
+    struct kralloc_link *link;
+    struct kregion *r;
+
+    a = kralloc_alloc(size, 0, 2 * KREGION_ALIGN + sizeof *link +
+                      sizeof *r + region_size, destructor);
+    if (!a)
+        return NULL;
+
+    link = kralloc_link_inline(a);
+    r = (struct kregion *)kregion_align(link + 1);
+    r->next = NULL;
+    r->pos = (u8 *)kregion_align(r + 1);
+    r->end = (u8 *)(r + 1) + region_size;
+    r->chunk_size = region_size;
+    link->region = r;
+    return (void *)(a + 1);
+}
+
+
+/**
+ * Add region chunk having at least 'need' bytes
+ */
+static struct kregion *kregion_grow(struct kralloc_link *link, uint need)
+{
+    struct kregion *r;
+    uint chunk_size = MAX(link->region->chunk_size, need);
+
+    r = (struct kregion *)malloc(KREGION_ALIGN + sizeof *r + chunk_size);
+    if (!r)
+        return NULL;
+
+    r->next = link->region;
+    r->pos = (u8 *)kregion_align(r + 1);
+    r->end = (u8 *)(r + 1) + chunk_size;
+    r->chunk_size = chunk_size;
+    link->region = r;
+    return r;
+}
+
+
+/**
+ * Allocate memory linked to mem_parent. If the root memory
+ * has a region the memory is carved from it, otherwise it is
+ * allocated by kref_alloc() and linked by kmem_link_to_kmem().
+ * Not thread safe against other allocations in the same region.
+ * @param mem_parent: pointer to memory allocated with kref_alloc()
+ * @param size: needed memory size
+ * @param destructor: destructor for this memory
+ */
+void *kref_alloc_in(void *mem_parent, uint size, void (*destructor)(void *mem))
+{
+    struct kralloc *a_parent = (struct kralloc *)mem_parent - 1;
+    struct kralloc *a_root, *a;
+    struct kralloc_link *link;
+    struct kregion *r;
+    uint need = kregion_align(sizeof *link + sizeof *a + size);
 
+    if (!kralloc_valid(a_parent))
+        return NULL;
+
+    a_root = kralloc_root(a_parent);
+    if (!a_root->link || !a_root->link->region) {
+        a = kralloc_alloc(size, 0, KREGION_ALIGN + sizeof *link, destructor);
+        if (!a)
+            return NULL;
+        kralloc_link_inline(a);
+        if (kralloc_link_to(a, a_root)) {
+            kralloc_free(a);
+            return NULL;
+        }
+        return (void *)(a + 1);
+    }
+
+    r = a_root->link->region;
+    if ((ulong)(r->end - r->pos) < need) {
+        r = kregion_grow(a_root->link, need);
+        if (!r)
+            return NULL;
+    }
+
+    /* link record is carved just before memory descriptor */
+    link = (struct kralloc_link *)r->pos;
+    a = (struct kralloc *)(link + 1);
+    r->pos += need;
+    a->shift_size = 0;
+    a->slab_class = 0;
+    a->slab_owner = 0;
+    kralloc_init(a, size, destructor);
+    memset(link, 0, sizeof *link);
+    link->root = a_root;
+    a->link = link;
+    a->flags |= KRALLOC_F_REGION | KRALLOC_F_LINKED | KRALLOC_F_LINK_INLINE;
+
+    /* only memories having destructor need to be visited on release */
+    if (destructor)
+        list_append(&a_root->link->list, &link->le, a);
     return (void *)(a + 1);
 }
 
@@ -140,13 +542,10 @@ void *kmem_ref(void *mem)
 {
     struct kralloc *a = (struct kralloc *)mem - 1;
 
-    if(strcmp(a->magic, "kralloc") != 0)
+    if (!kralloc_valid(a))
         return NULL;
 
-    if (a->linked_mem)
-        kref_get(&a->linked_mem->kref);
-    else
-        kref_get(&a->kref);
+    kralloc_get(kralloc_root(a));
     return mem;
 }
 
@@ -157,7 +556,7 @@ void *kmem_ref(void *mem)
 uint kmem_size(void *mem)
 {
     struct kralloc *a = (struct kralloc *)mem - 1;
-    if(strcmp(a->magic, "kralloc") != 0)
+    if (!kralloc_valid(a))
         return 0;
 
     return a->size;
@@ -165,41 +564,73 @@ uint kmem_size(void *mem)
 
 
 /**
- * Link kmem to another kmem. Set mem_new as child of root memory
- * @param mem_new - pointer to memory allocated with kref_alloc()
- * @param mem_parent - pointer to root memory allocated with kref_alloc()
- * @return 0 if ok
+ * Link memory descriptor to root memory descriptor
  */
-int kmem_link_to_kmem(void *mem_new, void *mem_parent)
+static int kralloc_link_to(struct kralloc *a_new, struct kralloc *a_root)
 {
-    struct kralloc *a_new = (struct kralloc *)mem_new - 1;
-    struct kralloc *a_parent = (struct kralloc *)mem_parent - 1;
-    struct kralloc *a_root;
+    struct kralloc_link *root_link, *new_link;
+    struct kralloc *a;
+    struct le *le, *safe_le;
 
-    if(strcmp(a_new->magic, "kralloc") != 0)
-        return -1;
+    /* already linked to this or another tree */
+    if (a_new->flags & KRALLOC_F_LINKED)
+        return a_new->link->root == a_root ? 0 : -1;
 
-    if(strcmp(a_parent->magic, "kralloc") != 0)
+    /* mem_parent must not be linked to mem_new */
+    if (a_root == a_new)
         return -1;
 
+    /* a region owner can't be a child */
+    if (a_new->link && a_new->link->region)
+        return -1;
 
-    /* find root memory descriptor */
-    a_root = a_parent;
-    while(a_root->linked_mem) {
-        a_root = a_root->linked_mem;
+    root_link = kralloc_link(a_root);
+    new_link = kralloc_link(a_new);
+    if (!root_link || !new_link)
+        return -1;
 
-        if(strcmp(a_root->magic, "kralloc") != 0)
-            return -1;
+    /* mem_new owns linked memories, move them to the new root
+     * to keep every descriptor pointing directly to its root */
+    LIST_FOREACH_SAFE(&new_link->list, le, safe_le) {
+        a = (struct kralloc *)list_ledata(le);
+        list_unlink(le);
+        list_append(&root_link->list, &a->link->le, a);
+        a->link->root = a_root;
     }
 
     /* add current memory descriptor to
      * head list of all linked descriptors */
-    list_append(&a_root->list, &a_new->le, a_new);
-    a_new->linked_mem = a_root; /* mark mem_new as child memory */
+    list_append(&root_link->list, &new_link->le, a_new);
+    new_link->root = a_root;
+    a_new->flags |= KRALLOC_F_LINKED; /* mark mem_new as child memory */
     return 0;
 }
 
 
+/**
+ * Link kmem to another kmem. Set mem_new as child of root memory
+ * of mem_parent. If mem_new has own linked memories they are moved
+ * to that root too, so the tree always stays one level deep.
+ * @param mem_new - pointer to memory allocated with kref_alloc()
+ * @param mem_parent - pointer to memory allocated with kref_alloc()
+ * @return 0 if ok, -1 if mem_new is linked to another tree
+ *         or linking would make a cycle
+ */
+int kmem_link_to_kmem(void *mem_new, void *mem_parent)
+{
+    struct kralloc *a_new = (struct kralloc *)mem_new - 1;
+    struct kralloc *a_parent = (struct kralloc *)mem_parent - 1;
+
+    if (!kralloc_valid(a_new))
+        return -1;
+
+    if (!kralloc_valid(a_parent))
+        return -1;
+
+    return kralloc_link_to(a_new, kralloc_root(a_parent));
+}
+
+
 /**
  * Get reference counter value
  * @param mem - pointer to memory allocated with kref_alloc()
@@ -209,16 +640,43 @@ int kmem_get_ref_count(void *mem)
     struct kralloc *a = (struct kralloc *)mem - 1;
     uint cnt;
 
-    if(strcmp(a->magic, "kralloc") != 0)
+    if (!kralloc_valid(a))
         return 0;
 
-    if (a->linked_mem)
-        cnt = a->linked_mem->kref.refcount;
+    a = kralloc_root(a);
+
+    if (a->flags & KRALLOC_F_BIASED)
+        cnt = kref_read_biased(&a->kref);
+    else if (a->flags & KRALLOC_F_ATOMIC)
+        cnt = kref_read(&a->kref.kref);
     else
-        cnt = a->kref.refcount;
+        cnt = a->kref.kref.refcount;
     return cnt;
 }
 
+
+/**
+ * Prepare memory to be passed to another thread.
+ * Memory allocated in KRALLOC_BIASED_REF mode is counted by
+ * the allocating thread without atomics, the owner must call
+ * this before handing a reference over, afterwards all threads
+ * count references atomically. No-op in other modes.
+ * @param mem - pointer to memory allocated with kref_alloc()
+ */
+void *kmem_handoff(void *mem)
+{
+    struct kralloc *a = (struct kralloc *)mem - 1;
+
+    if (!kralloc_valid(a))
+        return NULL;
+
+    a = kralloc_root(a);
+
+    if (a->flags & KRALLOC_F_BIASED)
+        kref_merge_biased(&a->kref);
+    return mem;
+}
+
 /**
  * Decrease memory link counter and free memory
  * if link counter reach to zero
@@ -240,13 +698,10 @@ void *_kmem_deref(void **mem)
 
     a = (struct kralloc *)m - 1;
 
-    if(strcmp(a->magic, "kralloc") != 0)
+    if (!kralloc_valid(a))
         return NULL;
 
-    if (a->linked_mem)
-        rc = kref_put(&a->linked_mem->kref, k_destructor);
-    else
-        rc = kref_put(&a->kref, k_destructor);
+    rc = kralloc_put(kralloc_root(a));
 
     if (rc) {
         *mem = NULL;
@@ -11,9 +11,26 @@ extern "C" {
 #include <string.h>
 #include "types.h"
 
+/** kref_alloc_init() flags */
+#define KRALLOC_SLAB (1 << 0) /**< Serve small objects from slab size classes */
+#define KRALLOC_ATOMIC_REF (1 << 1) /**< Thread safe kmem_ref()/kmem_deref() */
+#define KRALLOC_BIASED_REF (1 << 2) /**< Cheap refs for allocating thread, see kmem_handoff() */
+#define KRALLOC_HUGE_PAGES (1 << 3) /**< Back large blocks by huge pages, see kref_alloc_huge_threshold() */
+#define KRALLOC_NUMA_LOCAL (1 << 4) /**< Bind huge page blocks to NUMA node of allocating thread */
+#define KRALLOC_STATS (1 << 5) /**< Count memories per size class and destructor, see kstat.h */
+#define KRALLOC_LEAK_CHECK (1 << 6) /**< Record call stacks of sampled live memories, see kleak.h */
+#define KRALLOC_HEAP_PROF (1 << 7) /**< Poisson sampled heap profile, see kprof.h */
+#define KRALLOC_TRACE (1 << 8) /**< Record allocations for replay, see ktrace.h */
+
+int kref_alloc_init(uint flags);
+void kref_alloc_huge_threshold(uint size);
 void *kref_alloc_aligned(int size, uint align, void (*destructor)(void *mem));
+void *kref_alloc_region(uint size, uint region_size,
+                        void (*destructor)(void *mem));
+void *kref_alloc_in(void *mem_parent, uint size, void (*destructor)(void *mem));
 void *kmem_ref(void *mem);
 int kmem_link_to_kmem(void *mem_new, void *mem_parent);
+void *kmem_handoff(void *mem);
 
 void *_kmem_deref(void **mem);
 #define kmem_deref(mem) _kmem_deref((void **)(mem))
@@ -0,0 +1,347 @@
+#include "kslab.h"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+/** Minimal number of blocks carved from one slab */
+#define KSLAB_MIN_OBJS 8
+
+/** Free blocks kept by every thread per size class */
+#define KSLAB_MAG_SIZE 32
+
+/** Free block, the link is stored in the block itself */
+struct kslab_block {
+    struct kslab_block *next;
+};
+
+/** Size class depot shared by all threads */
+struct kslab_cache {
+    pthread_mutex_t lock;
+    struct kslab_block *freelist;  /**< Free blocks of this class */
+    uint nr_slabs;                 /**< Slabs carved for this class */
+};
+
+/** Per-thread magazine of free blocks */
+struct kslab_mag {
+    uint count;
+    void *objs[KSLAB_MAG_SIZE];
+};
+
+/** Per-thread cache, never freed but reused by new threads */
+struct kslab_tcache {
+    struct kslab_mag mags[KSLAB_NR_CLASSES];
+    /** Blocks freed by other threads, lock-free LIFO per class */
+    struct kslab_block *remote[KSLAB_NR_CLASSES];
+    struct kslab_tcache *next_free;
+    u16 id;
+};
+
+static struct kslab_cache kslab_caches[KSLAB_NR_CLASSES];
+static uint kslab_page_size;
+
+static pthread_once_t kslab_once = PTHREAD_ONCE_INIT;
+static pthread_key_t kslab_key;
+static pthread_mutex_t kslab_tc_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct kslab_tcache *kslab_tcaches[KSLAB_MAX_THREADS];
+static struct kslab_tcache *kslab_tc_free;
+static uint kslab_nr_tcaches;
+
+static __thread struct kslab_tcache *kslab_tc;
+static __thread bool kslab_tc_none;
+
+
+/**
+ * Get size class for block size
+ * Classes grow by 16 bytes up to 256 and then by four
+ * steps per power of two up to KSLAB_MAX_SIZE
+ * @param size: block size
+ * @return class index or 0 if size is too big for slabs
+ */
+int kslab_class(uint size)
+{
+    uint order, base, step;
+
+    if (size <= 256)
+        return size ? (size + 15) >> 4 : 1;
+
+    if (size > KSLAB_MAX_SIZE)
+        return 0;
+
+    order = 32 - __builtin_clz(size - 1);
+    base = 1 << (order - 1);
+    step = base >> 2;
+    return 16 + (order - 9) * 4 + (size - base + step - 1) / step;
+}
+
+
+/**
+ * Get block size served by size class
+ * @param cls: class index
+ */
+uint kslab_class_size(int cls)
+{
+    uint base;
+
+    if (cls <= 0 || cls >= KSLAB_NR_CLASSES)
+        return 0;
+
+    if (cls <= 16)
+        return cls << 4;
+
+    cls -= 17;
+    base = 256 << (cls / 4);
+    return base + (cls % 4 + 1) * (base >> 2);
+}
+
+
+/**
+ * Map new slab and put all its blocks to class freelist
+ * Called with class lock held
+ */
+static int kslab_grow(int cls)
+{
+    struct kslab_cache *c = kslab_caches + cls;
+    uint obj_size = kslab_class_size(cls);
+    uint slab_size, i, n;
+    u8 *slab;
+
+    slab_size = obj_size * KSLAB_MIN_OBJS;
+    slab_size = (slab_size + kslab_page_size - 1) & ~(kslab_page_size - 1);
+
+    slab = mmap(NULL, slab_size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (slab == MAP_FAILED)
+        return -1;
+
+    n = slab_size / obj_size;
+    for (i = 0; i < n; i++) {
+        struct kslab_block *b = (struct kslab_block *)(slab + i * obj_size);
+        b->next = c->freelist;
+        c->freelist = b;
+    }
+    c->nr_slabs++;
+    return 0;
+}
+
+
+/**
+ * Put chain of blocks to class depot
+ */
+static void kslab_depot_put(int cls, struct kslab_block *first,
+                            struct kslab_block *last)
+{
+    struct kslab_cache *c = kslab_caches + cls;
+
+    pthread_mutex_lock(&c->lock);
+    last->next = c->freelist;
+    c->freelist = first;
+    pthread_mutex_unlock(&c->lock);
+}
+
+
+/**
+ * Move 'count' blocks from top of magazine to class depot
+ */
+static void kslab_mag_flush(struct kslab_mag *mag, int cls, uint count)
+{
+    struct kslab_block *first, *b;
+    uint i;
+
+    if (!count)
+        return;
+
+    first = mag->objs[mag->count - count];
+    for (i = mag->count - count, b = first; i < mag->count - 1; i++) {
+        b->next = mag->objs[i + 1];
+        b = b->next;
+    }
+    mag->count -= count;
+    kslab_depot_put(cls, first, b);
+}
+
+
+/**
+ * Take up to 'count' blocks from class depot
+ * @return number of blocks put to 'objs'
+ */
+static uint kslab_depot_get(int cls, void **objs, uint count)
+{
+    struct kslab_cache *c = kslab_caches + cls;
+    uint n = 0;
+
+    pthread_mutex_lock(&c->lock);
+    if (!c->freelist)
+        kslab_grow(cls);
+
+    while (c->freelist && n < count) {
+        objs[n++] = c->freelist;
+        c->freelist = c->freelist->next;
+    }
+    pthread_mutex_unlock(&c->lock);
+    return n;
+}
+
+
+/**
+ * Give all cached blocks back to depot on thread exit
+ */
+static void kslab_tcache_release(void *arg)
+{
+    struct kslab_tcache *tc = (struct kslab_tcache *)arg;
+    struct kslab_block *b, *last;
+    int cls;
+
+    for (cls = 1; cls < KSLAB_NR_CLASSES; cls++) {
+        kslab_mag_flush(tc->mags + cls, cls, tc->mags[cls].count);
+
+        b = __atomic_exchange_n(tc->remote + cls, NULL, __ATOMIC_ACQUIRE);
+        if (!b)
+            continue;
+        for (last = b; last->next; last = last->next);
+        kslab_depot_put(cls, b, last);
+    }
+
+    kslab_tc = NULL;
+    pthread_mutex_lock(&kslab_tc_lock);
+    tc->next_free = kslab_tc_free;
+    kslab_tc_free = tc;
+    pthread_mutex_unlock(&kslab_tc_lock);
+}
+
+
+static void kslab_init(void)
+{
+    int cls;
+
+    kslab_page_size = (uint)sysconf(_SC_PAGESIZE);
+    for (cls = 0; cls < KSLAB_NR_CLASSES; cls++)
+        pthread_mutex_init(&kslab_caches[cls].lock, NULL);
+    pthread_key_create(&kslab_key, kslab_tcache_release);
+}
+
+
+/**
+ * Get cache of current thread, create it on first use.
+ * @return NULL if thread works directly with depot
+ */
+static struct kslab_tcache *kslab_tcache(void)
+{
+    struct kslab_tcache *tc;
+
+    if (kslab_tc || kslab_tc_none)
+        return kslab_tc;
+
+    pthread_once(&kslab_once, kslab_init);
+
+    pthread_mutex_lock(&kslab_tc_lock);
+    tc = kslab_tc_free;
+    if (tc) {
+        kslab_tc_free = tc->next_free;
+    } else if (kslab_nr_tcaches < KSLAB_MAX_THREADS) {
+        tc = (struct kslab_tcache *)calloc(1, sizeof *tc);
+        if (tc) {
+            tc->id = kslab_nr_tcaches;
+            kslab_tcaches[kslab_nr_tcaches++] = tc;
+        }
+    }
+    pthread_mutex_unlock(&kslab_tc_lock);
+
+    if (!tc) {
+        kslab_tc_none = TRUE;
+        return NULL;
+    }
+
+    pthread_setspecific(kslab_key, tc);
+    kslab_tc = tc;
+    return tc;
+}
+
+
+/**
+ * Refill empty magazine by blocks freed by other threads
+ */
+static void kslab_drain_remote(struct kslab_tcache *tc, int cls)
+{
+    struct kslab_mag *mag = tc->mags + cls;
+    struct kslab_block *b, *last;
+
+    b = __atomic_exchange_n(tc->remote + cls, NULL, __ATOMIC_ACQUIRE);
+    while (b && mag->count < KSLAB_MAG_SIZE) {
+        mag->objs[mag->count++] = b;
+        b = b->next;
+    }
+
+    if (!b)
+        return;
+    for (last = b; last->next; last = last->next);
+    kslab_depot_put(cls, b, last);
+}
+
+
+/**
+ * Get block of size class
+ * @param cls: class index returned by kslab_class()
+ * @param owner: returns thread cache id to be passed to kslab_free()
+ * @return block of kslab_class_size(cls) bytes or NULL
+ */
+void *kslab_alloc(int cls, u16 *owner)
+{
+    struct kslab_tcache *tc = kslab_tcache();
+    struct kslab_mag *mag;
+    void *obj;
+
+    if (!tc) {
+        *owner = KSLAB_NO_OWNER;
+        return kslab_depot_get(cls, &obj, 1) ? obj : NULL;
+    }
+
+    mag = tc->mags + cls;
+    if (!mag->count) {
+        if (__atomic_load_n(tc->remote + cls, __ATOMIC_RELAXED))
+            kslab_drain_remote(tc, cls);
+        if (!mag->count)
+            mag->count = kslab_depot_get(cls, mag->objs, KSLAB_MAG_SIZE / 2);
+        if (!mag->count)
+            return NULL;
+    }
+
+    *owner = tc->id;
+    return mag->objs[--mag->count];
+}
+
+
+/**
+ * Return block to its size class. Blocks allocated by
+ * another thread are queued to the owner thread cache.
+ * @param ptr: block returned by kslab_alloc()
+ * @param cls: class index used for allocation
+ * @param owner: thread cache id returned by kslab_alloc()
+ */
+void kslab_free(void *ptr, int cls, u16 owner)
+{
+    struct kslab_tcache *tc = kslab_tcache();
+    struct kslab_block *b = (struct kslab_block *)ptr;
+    struct kslab_mag *mag;
+    struct kslab_block **remote;
+
+    if (tc && tc->id == owner) {
+        mag = tc->mags + cls;
+        if (mag->count == KSLAB_MAG_SIZE)
+            kslab_mag_flush(mag, cls, KSLAB_MAG_SIZE / 2);
+        mag->objs[mag->count++] = ptr;
+        return;
+    }
+
+    if (owner == KSLAB_NO_OWNER) {
+        kslab_depot_put(cls, b, b);
+        return;
+    }
+
+    remote = kslab_tcaches[owner]->remote + cls;
+    b->next = __atomic_load_n(remote, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(remote, &b->next, b, TRUE,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
@@ -0,0 +1,31 @@
+#ifndef KSLAB_H_
+#define KSLAB_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "types.h"
+
+/** Largest block served by slabs, bigger requests go to malloc() */
+#define KSLAB_MAX_SIZE 8192
+
+/** Number of size classes, class 0 is reserved for "not a slab block" */
+#define KSLAB_NR_CLASSES 37
+
+/** Threads having own block cache, others share the depot */
+#define KSLAB_MAX_THREADS 1024
+
+/** Owner id of blocks taken directly from the depot */
+#define KSLAB_NO_OWNER 0xffff
+
+int kslab_class(uint size);
+uint kslab_class_size(int cls);
+void *kslab_alloc(int cls, u16 *owner);
+void kslab_free(void *ptr, int cls, u16 owner);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KSLAB_H_ */
@@ -0,0 +1,470 @@
+#define _GNU_SOURCE
+#include "kstat.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <dlfcn.h>
+#include <stdbool.h>
+
+/** Counters owned by one thread, other threads only read them */
+struct kstat_bucket {
+    unsigned long long allocs;
+    unsigned long long frees;
+    unsigned long long bytes_alloc;
+    unsigned long long bytes_freed;
+};
+
+struct kstat_dtor_slot {
+    void (*destructor)(void *mem);
+    bool used;
+    struct kstat_bucket b;
+    long long pending_bytes;  /* live bytes change not published yet */
+    long long live_bytes;     /* published, kstat_peaks only */
+    unsigned long long peak_bytes;
+};
+
+struct kstat_tcache {
+    struct kstat_bucket classes[KSTAT_NR_CLASSES];
+    long long class_pending[KSTAT_NR_CLASSES];
+    struct kstat_dtor_slot dtors[KSTAT_NR_DTORS + 1]; /* last is "other" */
+    long long pending_bytes;  /* live bytes change not published yet */
+    struct kstat_tcache *next;
+};
+
+static struct kstat_tcache *kstat_threads;
+/* counters of exited threads */
+static struct kstat_tcache kstat_dead;
+static pthread_mutex_t kstat_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t kstat_once = PTHREAD_ONCE_INIT;
+static pthread_key_t kstat_key;
+
+static long long kstat_live_bytes;
+static unsigned long long kstat_peak_bytes;
+/* published live bytes and peaks per class */
+static long long kstat_class_live[KSTAT_NR_CLASSES];
+static unsigned long long kstat_class_peak[KSTAT_NR_CLASSES];
+/* published live bytes and peaks per destructor, under kstat_lock */
+static struct kstat_tcache kstat_peaks;
+
+static __thread struct kstat_tcache *kstat_tc;
+
+
+/* counters are written only by owner thread, relaxed
+ * atomics make concurrent reads well defined */
+#define kstat_inc(var, val) \
+    __atomic_store_n(&(var), (var) + (val), __ATOMIC_RELAXED)
+#define kstat_load(var) __atomic_load_n(&(var), __ATOMIC_RELAXED)
+
+
+static void kstat_bucket_add(struct kstat_bucket *to,
+                             struct kstat_bucket *from)
+{
+    to->allocs += kstat_load(from->allocs);
+    to->frees += kstat_load(from->frees);
+    to->bytes_alloc += kstat_load(from->bytes_alloc);
+    to->bytes_freed += kstat_load(from->bytes_freed);
+}
+
+
+/**
+ * Find destructor slot, take free one if not found
+ */
+static struct kstat_dtor_slot *kstat_dtor_slot(struct kstat_tcache *tc,
+                                               void (*destructor)(void *mem))
+{
+    uint i, n, h = ((ulong)destructor >> 4) * 0x9e3779b1u;
+    struct kstat_dtor_slot *s;
+
+    for (i = 0, n = h % KSTAT_NR_DTORS; i < KSTAT_NR_DTORS;
+         i++, n = (n + 1) % KSTAT_NR_DTORS) {
+        s = tc->dtors + n;
+        if (s->used && s->destructor == destructor)
+            return s;
+        if (!s->used) {
+            s->destructor = destructor;
+            __atomic_store_n(&s->used, TRUE, __ATOMIC_RELEASE);
+            return s;
+        }
+    }
+
+    s = tc->dtors + KSTAT_NR_DTORS;
+    if (!s->used) {
+        s->destructor = KSTAT_DTOR_OTHER;
+        __atomic_store_n(&s->used, TRUE, __ATOMIC_RELEASE);
+    }
+    return s;
+}
+
+
+static void kstat_peak_update(unsigned long long *peak_bytes, long long live)
+{
+    unsigned long long peak;
+
+    peak = __atomic_load_n(peak_bytes, __ATOMIC_RELAXED);
+    while (live > (long long)peak &&
+           !__atomic_compare_exchange_n(peak_bytes, &peak, live, TRUE,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+
+/**
+ * Publish live bytes change, update peak
+ */
+static void kstat_flush(struct kstat_tcache *tc)
+{
+    long long live;
+
+    live = __atomic_add_fetch(&kstat_live_bytes, tc->pending_bytes,
+                              __ATOMIC_RELAXED);
+    tc->pending_bytes = 0;
+    kstat_peak_update(&kstat_peak_bytes, live);
+}
+
+
+/**
+ * Publish live bytes change of size class, update its peak
+ */
+static void kstat_flush_class(struct kstat_tcache *tc, int cls)
+{
+    long long live;
+
+    live = __atomic_add_fetch(kstat_class_live + cls, tc->class_pending[cls],
+                              __ATOMIC_RELAXED);
+    tc->class_pending[cls] = 0;
+    kstat_peak_update(kstat_class_peak + cls, live);
+}
+
+
+/**
+ * Publish live bytes change of destructor, update its peak
+ */
+static void kstat_flush_dtor(struct kstat_dtor_slot *s)
+{
+    struct kstat_dtor_slot *p;
+
+    pthread_mutex_lock(&kstat_lock);
+    p = kstat_dtor_slot(&kstat_peaks, s->destructor);
+    p->live_bytes += s->pending_bytes;
+    if (p->live_bytes > (long long)p->peak_bytes)
+        p->peak_bytes = p->live_bytes;
+    pthread_mutex_unlock(&kstat_lock);
+    s->pending_bytes = 0;
+}
+
+
+/**
+ * Publish all live bytes changes of thread
+ */
+static void kstat_flush_all(struct kstat_tcache *tc)
+{
+    int i;
+
+    kstat_flush(tc);
+    for (i = 0; i < KSTAT_NR_CLASSES; i++)
+        if (tc->class_pending[i])
+            kstat_flush_class(tc, i);
+    for (i = 0; i <= KSTAT_NR_DTORS; i++)
+        if (tc->dtors[i].used && tc->dtors[i].pending_bytes)
+            kstat_flush_dtor(tc->dtors + i);
+}
+
+
+/**
+ * Fold counters of exiting thread into kstat_dead
+ */
+static void kstat_tcache_release(void *arg)
+{
+    struct kstat_tcache *tc = (struct kstat_tcache *)arg;
+    struct kstat_tcache **p;
+    struct kstat_dtor_slot *s;
+    int i;
+
+    kstat_flush_all(tc);
+
+    pthread_mutex_lock(&kstat_lock);
+    for (p = &kstat_threads; *p; p = &(*p)->next) {
+        if (*p == tc) {
+            *p = tc->next;
+            break;
+        }
+    }
+
+    for (i = 0; i < KSTAT_NR_CLASSES; i++)
+        kstat_bucket_add(kstat_dead.classes + i, tc->classes + i);
+    for (i = 0; i <= KSTAT_NR_DTORS; i++) {
+        if (!tc->dtors[i].used)
+            continue;
+        s = kstat_dtor_slot(&kstat_dead, tc->dtors[i].destructor);
+        kstat_bucket_add(&s->b, &tc->dtors[i].b);
+    }
+    pthread_mutex_unlock(&kstat_lock);
+
+    kstat_tc = NULL;
+    free(tc);
+}
+
+
+static void kstat_init(void)
+{
+    pthread_key_create(&kstat_key, kstat_tcache_release);
+}
+
+
+static struct kstat_tcache *kstat_tcache(void)
+{
+    struct kstat_tcache *tc = kstat_tc;
+
+    if (tc)
+        return tc;
+
+    pthread_once(&kstat_once, kstat_init);
+    tc = (struct kstat_tcache *)calloc(1, sizeof *tc);
+    if (!tc)
+        return NULL;
+
+    pthread_mutex_lock(&kstat_lock);
+    tc->next = kstat_threads;
+    kstat_threads = tc;
+    pthread_mutex_unlock(&kstat_lock);
+
+    pthread_setspecific(kstat_key, tc);
+    kstat_tc = tc;
+    return tc;
+}
+
+
+static void kstat_account(uint size, int class_idx,
+                          void (*destructor)(void *mem), int alloc)
+{
+    struct kstat_tcache *tc = kstat_tcache();
+    struct kstat_bucket *cls, *dtor;
+    struct kstat_dtor_slot *s;
+    long long delta = alloc ? (long long)size : -(long long)size;
+
+    if (!tc)
+        return;
+
+    if (class_idx < 0 || class_idx >= KSTAT_NR_CLASSES)
+        class_idx = 0;
+    cls = tc->classes + class_idx;
+    s = kstat_dtor_slot(tc, destructor);
+    dtor = &s->b;
+    if (alloc) {
+        kstat_inc(cls->allocs, 1);
+        kstat_inc(cls->bytes_alloc, size);
+        kstat_inc(dtor->allocs, 1);
+        kstat_inc(dtor->bytes_alloc, size);
+    } else {
+        kstat_inc(cls->frees, 1);
+        kstat_inc(cls->bytes_freed, size);
+        kstat_inc(dtor->frees, 1);
+        kstat_inc(dtor->bytes_freed, size);
+    }
+    tc->pending_bytes += delta;
+    tc->class_pending[class_idx] += delta;
+    s->pending_bytes += delta;
+
+    if (tc->pending_bytes > KSTAT_FLUSH_BYTES ||
+        tc->pending_bytes < -KSTAT_FLUSH_BYTES)
+        kstat_flush(tc);
+    if (tc->class_pending[class_idx] > KSTAT_FLUSH_BYTES ||
+        tc->class_pending[class_idx] < -KSTAT_FLUSH_BYTES)
+        kstat_flush_class(tc, class_idx);
+    if (s->pending_bytes > KSTAT_FLUSH_BYTES ||
+        s->pending_bytes < -KSTAT_FLUSH_BYTES)
+        kstat_flush_dtor(s);
+}
+
+
+/**
+ * Count new memory, called by kref allocator
+ * @param size: requested size
+ * @param cls: kslab_class() of the whole block including allocator
+ *             header and alignment, 0 if bigger than slabs serve
+ * @param destructor: memory destructor
+ */
+void kstat_alloc(uint size, int cls, void (*destructor)(void *mem))
+{
+    kstat_account(size, cls, destructor, TRUE);
+}
+
+
+/**
+ * Count released memory, called by kref allocator
+ */
+void kstat_free(uint size, int cls, void (*destructor)(void *mem))
+{
+    kstat_account(size, cls, destructor, FALSE);
+}
+
+
+static void kstat_fill(struct kstat_counters *c, struct kstat_bucket *b,
+                       unsigned long long peak)
+{
+    c->allocs = b->allocs;
+    c->frees = b->frees;
+    c->alloc_bytes = b->bytes_alloc;
+    /* frees can be seen before allocs made by other threads */
+    c->live = b->allocs > b->frees ? b->allocs - b->frees : 0;
+    c->live_bytes = b->bytes_alloc > b->bytes_freed ?
+                    b->bytes_alloc - b->bytes_freed : 0;
+    /* unpublished changes can put current value above peak */
+    c->peak_bytes = MAX(peak, c->live_bytes);
+}
+
+
+/**
+ * Get counters of all memories. Peak is exact up to
+ * KSTAT_FLUSH_BYTES per thread.
+ */
+void kstat_get_total(struct kstat_counters *c)
+{
+    struct kstat_bucket sum;
+    struct kstat_tcache *tc;
+    int i;
+
+    memset(&sum, 0, sizeof sum);
+    pthread_mutex_lock(&kstat_lock);
+    for (i = 0; i < KSTAT_NR_CLASSES; i++) {
+        kstat_bucket_add(&sum, kstat_dead.classes + i);
+        for (tc = kstat_threads; tc; tc = tc->next)
+            kstat_bucket_add(&sum, tc->classes + i);
+    }
+    pthread_mutex_unlock(&kstat_lock);
+
+    kstat_fill(c, &sum, __atomic_load_n(&kstat_peak_bytes, __ATOMIC_RELAXED));
+}
+
+
+/**
+ * Get counters of size class, see kslab_class().
+ * Class 0 counts memories bigger than KSLAB_MAX_SIZE.
+ * Peak is exact up to KSTAT_FLUSH_BYTES per thread.
+ * @return 0 if ok
+ */
+int kstat_get_class(int cls, struct kstat_counters *c)
+{
+    struct kstat_bucket sum;
+    struct kstat_tcache *tc;
+
+    if (cls < 0 || cls >= KSTAT_NR_CLASSES)
+        return -1;
+
+    memset(&sum, 0, sizeof sum);
+    pthread_mutex_lock(&kstat_lock);
+    kstat_bucket_add(&sum, kstat_dead.classes + cls);
+    for (tc = kstat_threads; tc; tc = tc->next)
+        kstat_bucket_add(&sum, tc->classes + cls);
+    pthread_mutex_unlock(&kstat_lock);
+    kstat_fill(c, &sum, __atomic_load_n(kstat_class_peak + cls, __ATOMIC_RELAXED));
+    return 0;
+}
+
+
+static int kstat_dtor_cmp(const void *p1, const void *p2)
+{
+    const struct kstat_dtor *d1 = (const struct kstat_dtor *)p1;
+    const struct kstat_dtor *d2 = (const struct kstat_dtor *)p2;
+
+    if (d1->c.live_bytes != d2->c.live_bytes)
+        return d1->c.live_bytes < d2->c.live_bytes ? 1 : -1;
+    return d1->c.allocs < d2->c.allocs ? 1 : d1->c.allocs > d2->c.allocs ? -1 : 0;
+}
+
+
+/**
+ * Get counters per destructor, sorted by live bytes.
+ * Peak is exact up to KSTAT_FLUSH_BYTES per thread.
+ * @param dtors: array to fill
+ * @param max: array size
+ * @return number of destructors filled
+ */
+int kstat_get_dtors(struct kstat_dtor *dtors, int max)
+{
+    struct kstat_tcache sum, *tc;
+    struct kstat_dtor_slot *s, *from;
+    int i, n = 0;
+
+    memset(&sum, 0, sizeof sum);
+    pthread_mutex_lock(&kstat_lock);
+    for (tc = &kstat_dead; tc; tc = tc == &kstat_dead ? kstat_threads : tc->next) {
+        for (i = 0; i <= KSTAT_NR_DTORS; i++) {
+            from = tc->dtors + i;
+            if (!__atomic_load_n(&from->used, __ATOMIC_ACQUIRE))
+                continue;
+            s = kstat_dtor_slot(&sum, from->destructor);
+            kstat_bucket_add(&s->b, &from->b);
+        }
+    }
+    for (i = 0; i <= KSTAT_NR_DTORS; i++)
+        if (sum.dtors[i].used)
+            sum.dtors[i].peak_bytes = kstat_dtor_slot(&kstat_peaks,
+                                        sum.dtors[i].destructor)->peak_bytes;
+    pthread_mutex_unlock(&kstat_lock);
+
+    for (i = 0; i <= KSTAT_NR_DTORS && n < max; i++) {
+        if (!sum.dtors[i].used)
+            continue;
+        dtors[n].destructor = sum.dtors[i].destructor;
+        kstat_fill(&dtors[n].c, &sum.dtors[i].b, sum.dtors[i].peak_bytes);
+        n++;
+    }
+    qsort(dtors, n, sizeof *dtors, kstat_dtor_cmp);
+    return n;
+}
+
+
+static const char *kstat_dtor_name(void (*destructor)(void *mem),
+                                   char *name, uint size)
+{
+    Dl_info info;
+
+    if (!destructor)
+        return "(none)";
+    if (destructor == KSTAT_DTOR_OTHER)
+        return "(other)";
+    if (dladdr((void *)destructor, &info) && info.dli_sname)
+        return info.dli_sname;
+    snprintf(name, size, "%p", (void *)destructor);
+    return name;
+}
+
+
+/**
+ * Print statistics of all size classes and destructors
+ */
+void kstat_dump(FILE *f)
+{
+    struct kstat_dtor dtors[KSTAT_NR_DTORS + 1];
+    struct kstat_counters c;
+    char name[32];
+    int i, n;
+
+    kstat_get_total(&c);
+    fprintf(f, "kmem: allocs %llu frees %llu live %llu live_bytes %llu "
+            "peak_bytes %llu\n", c.allocs, c.frees, c.live, c.live_bytes,
+            c.peak_bytes);
+
+    fprintf(f, "%-10s %12s %12s %10s %14s %14s\n", "class", "allocs",
+            "frees", "live", "live_bytes", "peak_bytes");
+    for (i = 0; i < KSTAT_NR_CLASSES; i++) {
+        kstat_get_class(i, &c);
+        if (!c.allocs)
+            continue;
+        if (i)
+            fprintf(f, "%-10u", kslab_class_size(i));
+        else
+            fprintf(f, "%-10s", "large");
+        fprintf(f, " %12llu %12llu %10llu %14llu %14llu\n", c.allocs,
+                c.frees, c.live, c.live_bytes, c.peak_bytes);
+    }
+
+    n = kstat_get_dtors(dtors, KSTAT_NR_DTORS + 1);
+    fprintf(f, "%-24s %12s %12s %10s %14s %14s\n", "destructor", "allocs",
+            "frees", "live", "live_bytes", "peak_bytes");
+    for (i = 0; i < n; i++)
+        fprintf(f, "%-24s %12llu %12llu %10llu %14llu %14llu\n",
+                kstat_dtor_name(dtors[i].destructor, name, sizeof name), dtors[i].c.allocs,
+                dtors[i].c.frees, dtors[i].c.live, dtors[i].c.live_bytes,
+                dtors[i].c.peak_bytes);
+}
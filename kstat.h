@@ -0,0 +1,56 @@
+#ifndef KSTAT_H_
+#define KSTAT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include "types.h"
+#include "kslab.h"
+
+/**
+ * Size classes of kslab_class() applied to whole allocator blocks,
+ * header and alignment included, class 0 counts bigger memories
+ */
+#define KSTAT_NR_CLASSES KSLAB_NR_CLASSES
+
+/** Destructors tracked by every thread, the rest is counted as "other" */
+#define KSTAT_NR_DTORS 64
+
+/** Destructor key of memories counted in overflow slot */
+#define KSTAT_DTOR_OTHER ((void (*)(void *))-1L)
+
+/**
+ * Live bytes change of total, size class or destructor after which
+ * thread publishes it for peak tracking
+ */
+#define KSTAT_FLUSH_BYTES (64 * 1024)
+
+struct kstat_counters {
+    unsigned long long allocs;
+    unsigned long long frees;
+    unsigned long long alloc_bytes; /**< Bytes of all allocations     */
+    unsigned long long live;        /**< allocs - frees               */
+    unsigned long long live_bytes;
+    unsigned long long peak_bytes;  /**< Highest published live_bytes */
+};
+
+struct kstat_dtor {
+    void (*destructor)(void *mem);
+    struct kstat_counters c;
+};
+
+void kstat_alloc(uint size, int cls, void (*destructor)(void *mem));
+void kstat_free(uint size, int cls, void (*destructor)(void *mem));
+
+void kstat_get_total(struct kstat_counters *c);
+int kstat_get_class(int cls, struct kstat_counters *c);
+int kstat_get_dtors(struct kstat_dtor *dtors, int max);
+void kstat_dump(FILE *f);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KSTAT_H_ */
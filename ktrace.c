@@ -0,0 +1,220 @@
+#include "ktrace.h"
+#include "kref.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+/** Records buffered by every thread before writing */
+#define KTRACE_BUF_RECS 2048
+
+struct ktrace_buf {
+    pthread_mutex_t lock;  /* taken by owner and by ktrace_stop() */
+    uint nr;
+    uint gen;              /* session records were buffered in */
+    struct ktrace_buf *next;
+    struct ktrace_rec recs[KTRACE_BUF_RECS];
+};
+
+static FILE *ktrace_file;
+static int ktrace_on;
+/* session number, bumped by ktrace_start() */
+static uint ktrace_gen;
+/* lock order: ktrace_list_lock, buffer lock, ktrace_lock */
+static pthread_mutex_t ktrace_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t ktrace_list_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct ktrace_buf *ktrace_bufs;
+static pthread_once_t ktrace_once = PTHREAD_ONCE_INIT;
+static pthread_key_t ktrace_key;
+
+static __thread struct ktrace_buf *ktrace_tb;
+
+
+/**
+ * Write buffered records, called with buffer lock held
+ */
+static void ktrace_flush(struct ktrace_buf *tb)
+{
+    if (!tb->nr)
+        return;
+
+    /* records left from a stopped session are dropped */
+    pthread_mutex_lock(&ktrace_lock);
+    if (ktrace_file && tb->gen == ktrace_gen)
+        fwrite(tb->recs, sizeof tb->recs[0], tb->nr, ktrace_file);
+    pthread_mutex_unlock(&ktrace_lock);
+    tb->nr = 0;
+}
+
+
+static void ktrace_buf_release(void *arg)
+{
+    struct ktrace_buf *tb = (struct ktrace_buf *)arg;
+    struct ktrace_buf **p;
+
+    pthread_mutex_lock(&ktrace_list_lock);
+    for (p = &ktrace_bufs; *p; p = &(*p)->next) {
+        if (*p == tb) {
+            *p = tb->next;
+            break;
+        }
+    }
+    pthread_mutex_lock(&tb->lock);
+    ktrace_flush(tb);
+    pthread_mutex_unlock(&tb->lock);
+    pthread_mutex_unlock(&ktrace_list_lock);
+
+    ktrace_tb = NULL;
+    pthread_mutex_destroy(&tb->lock);
+    free(tb);
+}
+
+
+static void ktrace_init(void)
+{
+    pthread_key_create(&ktrace_key, ktrace_buf_release);
+}
+
+
+static struct ktrace_buf *ktrace_buf(void)
+{
+    struct ktrace_buf *tb = ktrace_tb;
+
+    if (tb)
+        return tb;
+
+    tb = (struct ktrace_buf *)malloc(sizeof *tb);
+    if (!tb)
+        return NULL;
+    pthread_mutex_init(&tb->lock, NULL);
+    tb->nr = 0;
+    tb->gen = __atomic_load_n(&ktrace_gen, __ATOMIC_RELAXED);
+
+    pthread_mutex_lock(&ktrace_list_lock);
+    tb->next = ktrace_bufs;
+    ktrace_bufs = tb;
+    pthread_mutex_unlock(&ktrace_list_lock);
+
+    pthread_setspecific(ktrace_key, tb);
+    ktrace_tb = tb;
+    return tb;
+}
+
+
+/**
+ * Start recording allocations of KRALLOC_TRACE memories to file
+ * @return 0 if ok
+ */
+int ktrace_start(const char *path)
+{
+    struct ktrace_header hdr = {KTRACE_MAGIC, KTRACE_VERSION,
+                                sizeof(struct ktrace_rec), 0};
+    FILE *f;
+
+    pthread_once(&ktrace_once, ktrace_init);
+    f = fopen(path, "w");
+    if (!f) {
+        print_e("can't open %s: %d\n", path, errno);
+        return -1;
+    }
+    fwrite(&hdr, sizeof hdr, 1, f);
+
+    pthread_mutex_lock(&ktrace_lock);
+    if (ktrace_file) {
+        pthread_mutex_unlock(&ktrace_lock);
+        fclose(f);
+        print_e("trace is already recorded\n");
+        return -1;
+    }
+    ktrace_file = f;
+    __atomic_add_fetch(&ktrace_gen, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&ktrace_on, TRUE, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&ktrace_lock);
+    return 0;
+}
+
+
+/**
+ * Stop recording, flush records of all threads and close file
+ */
+void ktrace_stop(void)
+{
+    struct ktrace_buf *tb;
+    FILE *f;
+
+    __atomic_store_n(&ktrace_on, FALSE, __ATOMIC_RELEASE);
+
+    pthread_mutex_lock(&ktrace_list_lock);
+    for (tb = ktrace_bufs; tb; tb = tb->next) {
+        pthread_mutex_lock(&tb->lock);
+        ktrace_flush(tb);
+        pthread_mutex_unlock(&tb->lock);
+    }
+    pthread_mutex_unlock(&ktrace_list_lock);
+
+    pthread_mutex_lock(&ktrace_lock);
+    f = ktrace_file;
+    ktrace_file = NULL;
+    pthread_mutex_unlock(&ktrace_lock);
+    if (f)
+        fclose(f);
+}
+
+
+static void ktrace_record(u8 type, const void *mem, uint size, uint align)
+{
+    struct ktrace_buf *tb = ktrace_buf();
+    struct ktrace_rec *rec;
+    struct timespec ts;
+    uint gen;
+
+    if (!tb)
+        return;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    pthread_mutex_lock(&tb->lock);
+    /* a record added after ktrace_stop() flushed this buffer
+     * must not end up in the next session */
+    gen = __atomic_load_n(&ktrace_gen, __ATOMIC_RELAXED);
+    if (tb->gen != gen) {
+        tb->nr = 0;
+        tb->gen = gen;
+    }
+    rec = tb->recs + tb->nr++;
+    rec->ts = (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    rec->addr = (ulong)mem;
+    rec->size = size;
+    rec->thread = kref_thread_id();
+    rec->type = type;
+    rec->align_order = align ? __builtin_ctz(align) + 1 : 0;
+    memset(rec->reserved, 0, sizeof rec->reserved);
+    if (tb->nr == KTRACE_BUF_RECS)
+        ktrace_flush(tb);
+    pthread_mutex_unlock(&tb->lock);
+}
+
+
+/**
+ * Record new memory if trace is started
+ * @return TRUE if memory is recorded and ktrace_free() must be called
+ */
+int ktrace_alloc(const void *mem, uint size, uint align)
+{
+    if (!__atomic_load_n(&ktrace_on, __ATOMIC_ACQUIRE))
+        return FALSE;
+    ktrace_record(KTRACE_ALLOC, mem, size, align);
+    return TRUE;
+}
+
+
+/**
+ * Record release of memory
+ */
+void ktrace_free(const void *mem)
+{
+    if (!__atomic_load_n(&ktrace_on, __ATOMIC_ACQUIRE))
+        return;
+    ktrace_record(KTRACE_FREE, mem, 0, 0);
+}
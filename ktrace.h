@@ -0,0 +1,48 @@
+#ifndef KTRACE_H_
+#define KTRACE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "types.h"
+
+#define KTRACE_MAGIC 0x4352544b /* "KTRC" */
+#define KTRACE_VERSION 2
+
+/** Trace file header */
+struct ktrace_header {
+    u32 magic;
+    u32 version;
+    u32 rec_size;   /**< sizeof(struct ktrace_rec) */
+    u32 reserved;
+};
+
+#define KTRACE_ALLOC 1
+#define KTRACE_FREE 2
+
+/**
+ * Trace record. Records of one thread are ordered, records of
+ * different threads are ordered by timestamp when replayed.
+ * Lifetime is the distance between alloc and free of the same address.
+ */
+struct ktrace_rec {
+    unsigned long long ts;    /**< CLOCK_MONOTONIC nanoseconds         */
+    unsigned long long addr;  /**< Memory address, identifies object   */
+    u32 size;                 /**< Requested size, alloc only          */
+    u32 thread;               /**< kref_thread_id() of caller          */
+    u8 type;                  /**< KTRACE_ALLOC or KTRACE_FREE         */
+    u8 align_order;           /**< log2(align) + 1 or 0 if not aligned */
+    u8 reserved[6];
+};
+
+int ktrace_start(const char *path);
+void ktrace_stop(void);
+int ktrace_alloc(const void *mem, uint size, uint align);
+void ktrace_free(const void *mem);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KTRACE_H_ */
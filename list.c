@@ -5,15 +5,14 @@
 static void list_destructor(void *mem)
 {
     struct list *list = (struct list *)mem;
-    struct le *le;
+    struct le *le, *safe_le;
     void *item;
 
-    LIST_FOREACH(list, le) {
+    LIST_FOREACH_SAFE(list, le, safe_le) {
         item = list_ledata(le);
+        list_unlink(le);
         kmem_deref(&item);
     }
-    list->head = NULL;
-    list->tail = NULL;
 }
 
 struct list *list_create()
@@ -34,6 +33,7 @@ void list_init(struct list *list)
 
     list->head = NULL;
     list->tail = NULL;
+    list->count = 0;
 }
 
 
@@ -90,6 +90,127 @@ void list_append(struct list *list, struct le *le, void *data)
         list->tail->next = le;
 
     list->tail = le;
+    list->count++;
+}
+
+
+/**
+ * Insert a list element at the beginning of a linked list
+ *
+ * @param list  Linked list
+ * @param le    List element
+ * @param data  Element data
+ */
+void list_insert_head(struct list *list, struct le *le, void *data)
+{
+    if (!list || !le)
+        return;
+
+    if (le->list)
+        return;
+
+    le->prev = NULL;
+    le->next = list->head;
+    le->list = list;
+    le->data = data;
+
+    if (list->head)
+        list->head->prev = le;
+    else
+        list->tail = le;
+
+    list->head = le;
+    list->count++;
+}
+
+
+/**
+ * Insert a list element before another one
+ *
+ * @param ref   Linked-in list element
+ * @param le    List element to insert
+ * @param data  Element data
+ */
+void list_insert_before(struct le *ref, struct le *le, void *data)
+{
+    struct list *list;
+
+    if (!ref || !ref->list || !le || le->list)
+        return;
+
+    list = ref->list;
+    le->prev = ref->prev;
+    le->next = ref;
+    le->list = list;
+    le->data = data;
+
+    if (ref->prev)
+        ref->prev->next = le;
+    else
+        list->head = le;
+
+    ref->prev = le;
+    list->count++;
+}
+
+
+/**
+ * Insert a list element after another one
+ *
+ * @param ref   Linked-in list element
+ * @param le    List element to insert
+ * @param data  Element data
+ */
+void list_insert_after(struct le *ref, struct le *le, void *data)
+{
+    struct list *list;
+
+    if (!ref || !ref->list || !le || le->list)
+        return;
+
+    list = ref->list;
+    le->prev = ref;
+    le->next = ref->next;
+    le->list = list;
+    le->data = data;
+
+    if (ref->next)
+        ref->next->prev = le;
+    else
+        list->tail = le;
+
+    ref->next = le;
+    list->count++;
+}
+
+
+/**
+ * Move all elements of one linked list to the end of another.
+ * Links are joined in constant time, only parent pointers of
+ * moved elements are updated one by one.
+ *
+ * @param dst   Destination list
+ * @param src   Source list, empty on return
+ */
+void list_splice(struct list *dst, struct list *src)
+{
+    struct le *le;
+
+    if (!dst || !src || dst == src || !src->head)
+        return;
+
+    for (le = src->head; le; le = le->next)
+        le->list = dst;
+
+    src->head->prev = dst->tail;
+    if (dst->tail)
+        dst->tail->next = src->head;
+    else
+        dst->head = src->head;
+
+    dst->tail = src->tail;
+    dst->count += src->count;
+    list_init(src);
 }
 
 
@@ -121,6 +242,7 @@ void list_unlink(struct le *le)
     le->next = NULL;
     le->prev = NULL;
     le->list = NULL;
+    list->count--;
 }
 
 
@@ -162,16 +284,7 @@ struct le *list_tail(const struct list *list)
  */
 int list_count(const struct list *list)
 {
-    int n = 0;
-    struct le *le;
-
-    if (!list)
-        return 0;
-
-    for (le = list->head; le; le = le->next)
-        ++n;
-
-    return n;
+    return list ? (int)list->count : 0;
 }
 
 /**
@@ -179,9 +292,10 @@ int list_count(const struct list *list)
  */
 void list_destroy(struct list *list)
 {
-    struct le *le;
-    LIST_FOREACH(list, le) {
+    struct le *le, *safe_le;
+    LIST_FOREACH_SAFE(list, le, safe_le) {
         void *item = list_ledata(le);
+        list_unlink(le);
         kmem_deref(&item);
     }
 
@@ -26,10 +26,11 @@ struct le {
 struct list {
     struct le *head;  /**< First list element */
     struct le *tail;  /**< Last list element  */
+    uint count;       /**< Number of elements */
 };
 
 /** Linked list Initializer */
-#define LIST_INIT {NULL, NULL}
+#define LIST_INIT {NULL, NULL, 0}
 
 
 
@@ -37,6 +38,10 @@ void list_init(struct list *list);
 struct list *list_create();
 void list_clear(struct list *list);
 void list_append(struct list *list, struct le *le, void *data);
+void list_insert_head(struct list *list, struct le *le, void *data);
+void list_insert_before(struct le *ref, struct le *le, void *data);
+void list_insert_after(struct le *ref, struct le *le, void *data);
+void list_splice(struct list *dst, struct list *src);
 void list_unlink(struct le *le);
 struct le *list_head(const struct list *list);
 struct le *list_tail(const struct list *list);
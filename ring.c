@@ -0,0 +1,281 @@
+#include "ring.h"
+#include "kref_alloc.h"
+#include <stdio.h>
+#include <limits.h>
+
+/**
+ * Round ring size up to power of two
+ * @param hdr: size of ring header
+ * @param slot: size of one slot
+ * @return 0 if ring of hdr + slots bytes doesn't fit kref_alloc_aligned()
+ */
+static uint ring_size(uint size, size_t hdr, size_t slot)
+{
+    uint nr;
+
+    if (size < 2)
+        size = 2;
+    if (size > (1U << 30))
+        return 0;
+    nr = 1U << (32 - __builtin_clz(size - 1));
+    if ((INT_MAX - hdr) / slot < nr)
+        return 0;
+    return nr;
+}
+
+
+/**
+ * Get number of pointers before the first NULL, NULL can't be queued
+ * as it can't be told apart from an empty ring
+ */
+static uint ring_valid_count(void **mems, uint n)
+{
+    uint i;
+
+    for (i = 0; i < n && mems[i]; i++);
+    return i;
+}
+
+
+static void ring_spsc_destructor(void *mem)
+{
+    struct ring_spsc *ring = (struct ring_spsc *)mem;
+    void *obj;
+
+    while ((obj = ring_spsc_dequeue(ring)))
+        kmem_deref(&obj);
+}
+
+/**
+ * Create single producer, single consumer ring
+ * @param size: capacity, rounded up to power of two
+ */
+struct ring_spsc *ring_spsc_create(uint size)
+{
+    struct ring_spsc *ring;
+    uint nr = ring_size(size, sizeof *ring, sizeof(void *));
+
+    if (!nr) {
+        print_e("ring size is too big: %u\n", size);
+        return NULL;
+    }
+
+    ring = (struct ring_spsc *)kref_alloc_aligned(
+                sizeof *ring + nr * sizeof(void *), RING_CACHE_LINE,
+                ring_spsc_destructor);
+    if (!ring)
+        return NULL;
+
+    memset(ring, 0, sizeof *ring);
+    ring->mask = nr - 1;
+    return ring;
+}
+
+/**
+ * Put up to 'n' pointers to ring, stops at the first NULL
+ * @return number of pointers queued
+ */
+uint ring_spsc_enqueue_bulk(struct ring_spsc *ring, void **mems, uint n)
+{
+    uint tail = ring->tail;
+    uint free_slots, i;
+
+    n = ring_valid_count(mems, n);
+
+    free_slots = ring->mask + 1 - (tail - ring->head_cache);
+    if (free_slots < n) {
+        ring->head_cache = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        free_slots = ring->mask + 1 - (tail - ring->head_cache);
+        n = MIN(n, free_slots);
+    }
+
+    for (i = 0; i < n; i++)
+        ring->slots[(tail + i) & ring->mask] = mems[i];
+
+    __atomic_store_n(&ring->tail, tail + n, __ATOMIC_RELEASE);
+    return n;
+}
+
+/**
+ * Take up to 'n' pointers from ring
+ * @return number of pointers put to 'mems'
+ */
+uint ring_spsc_dequeue_bulk(struct ring_spsc *ring, void **mems, uint n)
+{
+    uint head = ring->head;
+    uint used, i;
+
+    used = ring->tail_cache - head;
+    if (used < n) {
+        ring->tail_cache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        used = ring->tail_cache - head;
+        n = MIN(n, used);
+    }
+
+    for (i = 0; i < n; i++)
+        mems[i] = ring->slots[(head + i) & ring->mask];
+
+    __atomic_store_n(&ring->head, head + n, __ATOMIC_RELEASE);
+    return n;
+}
+
+/**
+ * @return 0 if ok, -1 if ring is full or mem is NULL
+ */
+int ring_spsc_enqueue(struct ring_spsc *ring, void *mem)
+{
+    return ring_spsc_enqueue_bulk(ring, &mem, 1) ? 0 : -1;
+}
+
+/**
+ * @return pointer or NULL if ring is empty
+ */
+void *ring_spsc_dequeue(struct ring_spsc *ring)
+{
+    void *mem;
+    return ring_spsc_dequeue_bulk(ring, &mem, 1) ? mem : NULL;
+}
+
+
+static void ring_mpmc_destructor(void *mem)
+{
+    struct ring_mpmc *ring = (struct ring_mpmc *)mem;
+    void *obj;
+
+    while ((obj = ring_mpmc_dequeue(ring)))
+        kmem_deref(&obj);
+}
+
+/**
+ * Create multi producer, multi consumer ring
+ * @param size: capacity, rounded up to power of two
+ */
+struct ring_mpmc *ring_mpmc_create(uint size)
+{
+    struct ring_mpmc *ring;
+    uint nr = ring_size(size, sizeof *ring, sizeof(struct ring_mpmc_cell));
+    uint i;
+
+    if (!nr) {
+        print_e("ring size is too big: %u\n", size);
+        return NULL;
+    }
+
+    ring = (struct ring_mpmc *)kref_alloc_aligned(
+                sizeof *ring + nr * sizeof(struct ring_mpmc_cell),
+                RING_CACHE_LINE, ring_mpmc_destructor);
+    if (!ring)
+        return NULL;
+
+    memset(ring, 0, sizeof *ring);
+    ring->mask = nr - 1;
+    for (i = 0; i < nr; i++)
+        ring->cells[i].seq = i;
+    return ring;
+}
+
+/**
+ * Put up to 'n' pointers to ring, stops at the first NULL.
+ * Slots are claimed by one CAS for the whole batch.
+ * @return number of pointers queued
+ */
+uint ring_mpmc_enqueue_bulk(struct ring_mpmc *ring, void **mems, uint n)
+{
+    struct ring_mpmc_cell *cell;
+    uint pos, seq = 0, i;
+
+    n = ring_valid_count(mems, n);
+    if (!n)
+        return 0;
+
+    pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    for (;;) {
+        for (i = 0; i < n; i++) {
+            cell = ring->cells + ((pos + i) & ring->mask);
+            seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+            if (seq != pos + i)
+                break;
+        }
+
+        if (!i) {
+            /* slot is still used by consumer: ring is full */
+            if ((int)(seq - pos) < 0)
+                return 0;
+            pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        if (__atomic_compare_exchange_n(&ring->tail, &pos, pos + i, TRUE,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            break;
+    }
+
+    n = i;
+    for (i = 0; i < n; i++) {
+        cell = ring->cells + ((pos + i) & ring->mask);
+        cell->data = mems[i];
+        __atomic_store_n(&cell->seq, pos + i + 1, __ATOMIC_RELEASE);
+    }
+    return n;
+}
+
+/**
+ * Take up to 'n' pointers from ring
+ * @return number of pointers put to 'mems'
+ */
+uint ring_mpmc_dequeue_bulk(struct ring_mpmc *ring, void **mems, uint n)
+{
+    struct ring_mpmc_cell *cell;
+    uint pos, seq = 0, i;
+
+    if (!n)
+        return 0;
+
+    pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    for (;;) {
+        for (i = 0; i < n; i++) {
+            cell = ring->cells + ((pos + i) & ring->mask);
+            seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+            if (seq != pos + i + 1)
+                break;
+        }
+
+        if (!i) {
+            /* slot is not filled by producer yet: ring is empty */
+            if ((int)(seq - (pos + 1)) < 0)
+                return 0;
+            pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        if (__atomic_compare_exchange_n(&ring->head, &pos, pos + i, TRUE,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            break;
+    }
+
+    n = i;
+    for (i = 0; i < n; i++) {
+        cell = ring->cells + ((pos + i) & ring->mask);
+        mems[i] = cell->data;
+        __atomic_store_n(&cell->seq, pos + i + ring->mask + 1,
+                         __ATOMIC_RELEASE);
+    }
+    return n;
+}
+
+/**
+ * @return 0 if ok, -1 if ring is full or mem is NULL
+ */
+int ring_mpmc_enqueue(struct ring_mpmc *ring, void *mem)
+{
+    return ring_mpmc_enqueue_bulk(ring, &mem, 1) ? 0 : -1;
+}
+
+/**
+ * @return pointer or NULL if ring is empty
+ */
+void *ring_mpmc_dequeue(struct ring_mpmc *ring)
+{
+    void *mem;
+    return ring_mpmc_dequeue_bulk(ring, &mem, 1) ? mem : NULL;
+}
@@ -0,0 +1,61 @@
+#ifndef RING_H_
+#define RING_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "types.h"
+
+#define RING_CACHE_LINE 64
+
+/**
+ * Bounded lock-free queues of kref_alloc() pointers.
+ * Enqueue passes caller's reference to the ring, dequeue passes it
+ * to the consumer. References left in the ring are dropped by ring
+ * destructor. NULL can't be queued.
+ */
+
+/** Single producer, single consumer ring */
+struct ring_spsc {
+    /* producer side */
+    uint tail __attribute__((aligned(RING_CACHE_LINE)));
+    uint head_cache;    /**< Last seen consumer position */
+    /* consumer side */
+    uint head __attribute__((aligned(RING_CACHE_LINE)));
+    uint tail_cache;    /**< Last seen producer position */
+
+    uint mask __attribute__((aligned(RING_CACHE_LINE)));
+    void *slots[];
+};
+
+/** Multi producer, multi consumer ring, bounded queue by D. Vyukov */
+struct ring_mpmc_cell {
+    uint seq;
+    void *data;
+};
+
+struct ring_mpmc {
+    uint tail __attribute__((aligned(RING_CACHE_LINE)));
+    uint head __attribute__((aligned(RING_CACHE_LINE)));
+    uint mask __attribute__((aligned(RING_CACHE_LINE)));
+    struct ring_mpmc_cell cells[];
+};
+
+struct ring_spsc *ring_spsc_create(uint size);
+int ring_spsc_enqueue(struct ring_spsc *ring, void *mem);
+void *ring_spsc_dequeue(struct ring_spsc *ring);
+uint ring_spsc_enqueue_bulk(struct ring_spsc *ring, void **mems, uint n);
+uint ring_spsc_dequeue_bulk(struct ring_spsc *ring, void **mems, uint n);
+
+struct ring_mpmc *ring_mpmc_create(uint size);
+int ring_mpmc_enqueue(struct ring_mpmc *ring, void *mem);
+void *ring_mpmc_dequeue(struct ring_mpmc *ring);
+uint ring_mpmc_enqueue_bulk(struct ring_mpmc *ring, void **mems, uint n);
+uint ring_mpmc_dequeue_bulk(struct ring_mpmc *ring, void **mems, uint n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RING_H_ */
@@ -2,6 +2,7 @@
 #define FALSE 0
 
 typedef unsigned char u8;
+typedef unsigned short u16;
 typedef unsigned int u32;
 typedef u8 byte;
 typedef unsigned int uint;
@@ -0,0 +1,129 @@
+#include "ulist.h"
+#include "kref_alloc.h"
+#include <stdlib.h>
+#include <string.h>
+
+static void ulist_destructor(void *mem)
+{
+    ulist_clear((struct ulist *)mem);
+}
+
+struct ulist *ulist_create(void)
+{
+    struct ulist *ul;
+    return (struct ulist *)kzref_alloc(sizeof *ul, ulist_destructor);
+}
+
+/**
+ * Append item to the end of list, list takes caller's reference
+ * @return 0 if ok
+ */
+int ulist_append(struct ulist *ul, void *item)
+{
+    struct ulist_chunk *c = ul->tail;
+
+    if (!item)
+        return -1;
+
+    if (!c || c->count == ULIST_CHUNK_ITEMS) {
+        c = (struct ulist_chunk *)malloc(sizeof *c);
+        if (!c) {
+            print_e("can't allocate ulist chunk\n");
+            return -1;
+        }
+        c->prev = ul->tail;
+        c->next = NULL;
+        c->count = 0;
+        if (ul->tail)
+            ul->tail->next = c;
+        else
+            ul->head = c;
+        ul->tail = c;
+    }
+
+    c->items[c->count++] = item;
+    ul->count++;
+    return 0;
+}
+
+static void ulist_chunk_unlink(struct ulist *ul, struct ulist_chunk *c)
+{
+    if (c->prev)
+        c->prev->next = c->next;
+    else
+        ul->head = c->next;
+
+    if (c->next)
+        c->next->prev = c->prev;
+    else
+        ul->tail = c->prev;
+    free(c);
+}
+
+/**
+ * Remove item at iterator position. Iterator is moved back so that
+ * ulist_iter_next() returns item which followed removed one, items
+ * can be removed inside ULIST_FOREACH. Half-empty neighbour chunks
+ * are merged to keep storage dense.
+ * @return removed item, reference is passed to caller
+ */
+void *ulist_remove(struct ulist *ul, struct ulist_iter *it)
+{
+    struct ulist_chunk *c = it->chunk, *next;
+    void *item;
+
+    if (!c || it->idx < 0 || (uint)it->idx >= c->count)
+        return NULL;
+
+    item = c->items[it->idx];
+    c->count--;
+    memmove(c->items + it->idx, c->items + it->idx + 1,
+            (c->count - it->idx) * sizeof(void *));
+    ul->count--;
+
+    if (!c->count) {
+        it->chunk = c->next;
+        it->idx = -1;
+        ulist_chunk_unlink(ul, c);
+        return item;
+    }
+    it->idx--;
+
+    /* items of next chunk go after iterator, it stays valid */
+    next = c->next;
+    if (next && c->count + next->count <= ULIST_CHUNK_ITEMS / 2) {
+        memcpy(c->items + c->count, next->items, next->count * sizeof(void *));
+        c->count += next->count;
+        ulist_chunk_unlink(ul, next);
+    }
+    return item;
+}
+
+/**
+ * Deref all items and free chunks
+ */
+void ulist_clear(struct ulist *ul)
+{
+    struct ulist_chunk *c, *next;
+    uint i;
+
+    if (!ul)
+        return;
+
+    for (c = ul->head; c; c = next) {
+        next = c->next;
+        for (i = 0; i < c->count; i++)
+            kmem_deref(c->items + i);
+        free(c);
+    }
+    ul->head = ul->tail = NULL;
+    ul->count = 0;
+}
+
+/**
+ * deref all list items and self list
+ */
+void ulist_destroy(struct ulist *ul)
+{
+    kmem_deref(&ul);
+}
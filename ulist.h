@@ -0,0 +1,103 @@
+#ifndef ULIST_H_
+#define ULIST_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include "types.h"
+
+/** Items per chunk, chunk is 512 bytes on 64-bit */
+#define ULIST_CHUNK_ITEMS 61
+
+/** Objects ahead of iterator prefetched by ULIST_FOREACH */
+#define ULIST_PREFETCH 4
+
+/**
+ * Unrolled list of kref_alloc() pointers stored in contiguous chunks.
+ * Append passes caller's reference to the list, remove passes it back.
+ * References left in the list are dropped by list destructor like
+ * list_destroy() does. NULL can't be stored.
+ */
+struct ulist_chunk {
+    struct ulist_chunk *prev;
+    struct ulist_chunk *next;
+    uint count;
+    void *items[ULIST_CHUNK_ITEMS];
+};
+
+struct ulist {
+    struct ulist_chunk *head;
+    struct ulist_chunk *tail;
+    uint count;
+};
+
+/** Position in unrolled list */
+struct ulist_iter {
+    struct ulist_chunk *chunk;
+    int idx;
+};
+
+struct ulist *ulist_create(void);
+int ulist_append(struct ulist *ul, void *item);
+void *ulist_remove(struct ulist *ul, struct ulist_iter *it);
+void ulist_clear(struct ulist *ul);
+void ulist_destroy(struct ulist *ul);
+
+static inline uint ulist_count(const struct ulist *ul)
+{
+    return ul ? ul->count : 0;
+}
+
+static inline void ulist_prefetch(const struct ulist_iter *it)
+{
+    const struct ulist_chunk *c = it->chunk;
+
+    if ((uint)it->idx + ULIST_PREFETCH < c->count)
+        __builtin_prefetch(c->items[it->idx + ULIST_PREFETCH]);
+    else if (c->next)
+        __builtin_prefetch(c->next->items[0]);
+}
+
+static inline void *ulist_iter_first(const struct ulist *ul, struct ulist_iter *it)
+{
+    it->chunk = ul ? ul->head : NULL;
+    it->idx = 0;
+    if (!it->chunk)
+        return NULL;
+    if (it->chunk->next)
+        __builtin_prefetch(it->chunk->next);
+    return it->chunk->items[0];
+}
+
+/**
+ * Move to next item, prefetching following chunk on entering a chunk
+ * and the object ULIST_PREFETCH positions ahead.
+ * @return next item or NULL at the end
+ */
+static inline void *ulist_iter_next(struct ulist_iter *it)
+{
+    if (!it->chunk)
+        return NULL;
+
+    if ((uint)++it->idx >= it->chunk->count) {
+        it->chunk = it->chunk->next;
+        it->idx = 0;
+        if (!it->chunk)
+            return NULL;
+        if (it->chunk->next)
+            __builtin_prefetch(it->chunk->next);
+    }
+    ulist_prefetch(it);
+    return it->chunk->items[it->idx];
+}
+
+#define ULIST_FOREACH(ul, it, item) \
+    for ((item) = ulist_iter_first((ul), &(it)); (item); (item) = ulist_iter_next(&(it)))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ULIST_H_ */